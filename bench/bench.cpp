@@ -0,0 +1,82 @@
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "bench.h"
+
+static thread_local uint64_t sAllocations = 0;
+
+// Count every allocation the code under test makes
+void* operator new(size_t size)
+{
+    sAllocations++;
+    void* p = malloc(size > 0 ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+namespace bench {
+
+uint64_t allocations()
+{
+    return sAllocations;
+}
+
+static std::vector<std::pair<const char*, Function> >& registry()
+{
+    static std::vector<std::pair<const char*, Function> > sRegistry;
+    return sRegistry;
+}
+
+Registration::Registration(const char* name, Function function)
+{
+    registry().push_back({name, function});
+}
+
+void report(const std::string& name, uint64_t ops, uint64_t ns, uint64_t allocs)
+{
+    std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(1)
+        << std::setw(12) << static_cast<double>(ns) / ops << " ns/op"
+        << std::setprecision(2) << std::setw(10) << static_cast<double>(allocs) / ops << " allocs/op\n";
+}
+
+}
+
+// Runs every benchmark, or those whose name contains one of the arguments
+int main(int argc, char* argv[])
+{
+    for (auto& entry: bench::registry()) {
+        bool run = argc < 2;
+        for (int i = 1; i < argc; i++) {
+            run = run || strstr(entry.first, argv[i]) != nullptr;
+        }
+
+        if (run) {
+            std::cout << "# " << entry.first << "\n";
+            entry.second();
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+#ifndef CECFORWARDER_BENCH_H
+#define CECFORWARDER_BENCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace bench {
+
+typedef void (*Function)();
+
+struct Registration {
+    Registration(const char* name, Function function);
+};
+
+void report(const std::string& name, uint64_t ops, uint64_t ns, uint64_t allocs);
+
+// Heap allocations made so far by the calling thread
+uint64_t allocations();
+
+// Run f() ops times and report the time and allocations per call
+template<typename F>
+void measure(const std::string& name, uint64_t ops, F f)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    uint64_t allocs = allocations();
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        f(i);
+    }
+
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    report(name, ops, ns, allocations() - allocs);
+}
+
+// Keep the optimiser from dropping a result
+template<typename T>
+void keep(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+}
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static bench::Registration name##Registration(#name, name); \
+    static void name()
+
+#endif // CECFORWARDER_BENCH_H
@@ -0,0 +1,80 @@
+// HueConfig against ConfigFile on a generated file far larger than any
+// real one
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "bench.h"
+#include "config.h"
+#include "configfile.h"
+
+BENCHMARK(config)
+{
+    char path[] = "/tmp/cecforwarder-bench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        perror("mkstemp");
+        return;
+    }
+
+    close(fd);
+
+    // 10k lines: a header, a comment and 198 keys per section
+    const unsigned int sections = 50, keys = 198;
+    {
+        std::ofstream file(path);
+        for (unsigned int s = 0; s < sections; s++) {
+            file << "[Section" << s << "]\n";
+            file << "# Comment line " << s << "\n";
+            for (unsigned int k = 0; k < keys; k++) {
+                file << "KEY_" << k << "=0x" << std::hex << (0x00FF0000U + s * keys + k) << std::dec << "\n";
+            }
+        }
+    }
+
+    const uint64_t ops = 200;
+    bench::measure("HueConfig parse, 10k lines", ops, [&](uint64_t i) {
+        HueConfig config(path);
+        bench::keep(config.parse());
+    });
+
+    bench::measure("ConfigFile parse, 10k lines", ops, [&](uint64_t i) {
+        ConfigFile config(path);
+        bench::keep(config.parse());
+    });
+
+    HueConfig config(path);
+    config.parse();
+    bench::measure("HueConfig section value", 1000000, [&](uint64_t i) {
+        HueConfigSection* section = config.getSection("Section" + std::to_string(i % sections));
+        bench::keep(section->value("KEY_50"));
+    });
+
+    bench::measure("HueConfig section int value", 1000000, [&](uint64_t i) {
+        HueConfigSection* section = config.getSection("Section" + std::to_string(i % sections));
+        bench::keep(section->intValue("KEY_50"));
+    });
+
+    // Names built up front, so only the lookups are measured
+    std::vector<std::string> names;
+    for (unsigned int s = 0; s < sections; s++) {
+        names.push_back("Section" + std::to_string(s));
+    }
+
+    ConfigFile file(path);
+    file.parse();
+    bench::measure("ConfigFile section value", 1000000, [&](uint64_t i) {
+        const ConfigFile::Section* section = file.getSection(names[i % sections].c_str());
+        bench::keep(section->value("KEY_50"));
+    });
+
+    bench::measure("ConfigFile section int value", 1000000, [&](uint64_t i) {
+        const ConfigFile::Section* section = file.getSection(names[i % sections].c_str());
+        bench::keep(section->intValue("KEY_50"));
+    });
+
+    unlink(path);
+}
@@ -0,0 +1,167 @@
+// Throughput of the table-driven IRDecoder against the original
+// whole-frame NEC and RC5 decoders it replaced.
+
+#include <cmath>
+#include <bitset>
+#include <vector>
+
+#include "bench.h"
+#include "irdecoder.h"
+
+static bool checkTarget(unsigned int value, unsigned int target)
+{
+    float diff = 1.0f - (value / static_cast<float>(target));
+    return std::abs(floor(diff * 100.0f)) < 25;
+}
+
+// The decoders as they were, kept here for comparison
+static bool legacyDataToKeyNEC(const std::vector<unsigned int>& data, uint32_t& value)
+{
+    if (!checkTarget(data[0], 9000) || !checkTarget(data[1], 4500)) {
+        return false;
+    }
+
+    std::bitset<32> bits;
+    for (unsigned int i = 2, shift = 31; i < data.size() - 1; i += 2, shift--) {
+        unsigned int pulse = data[i];
+        unsigned int space = data[i + 1];
+        if (!checkTarget(pulse, 563)) {
+            return false;
+        }
+
+        if (checkTarget(space, 563)) {
+            bits[shift] = 0;
+        } else if (checkTarget(space, 1687)) {
+            bits[shift] = 1;
+        } else {
+            return false;
+        }
+    }
+
+    value = static_cast<uint32_t>(bits.to_ulong());
+    return true;
+}
+
+static bool legacyDataToKeyRC5(const std::vector<unsigned int>& data, uint32_t& value)
+{
+    if (data.size() < 13) {
+        return false;
+    }
+
+    if (!checkTarget(data[0], 889)) {
+        return false;
+    }
+
+    std::vector<bool> deflatedData;
+    for (unsigned int offset = 1; offset < data.size(); offset++)
+    {
+        bool pulse = (offset % 2);
+        if (checkTarget(data[offset], 889 * 3)) {
+            deflatedData.push_back(pulse);
+            deflatedData.push_back(pulse);
+            deflatedData.push_back(pulse);
+        } else if (checkTarget(data[offset], 889 * 2)) {
+            deflatedData.push_back(pulse);
+            deflatedData.push_back(pulse);
+        } else if (checkTarget(data[offset], 889)) {
+            deflatedData.push_back(pulse);
+        }
+    }
+
+    std::bitset<32> bits;
+    for (unsigned int i = 0, shift = 31; i < deflatedData.size(); i += 2, shift--) {
+        if (!deflatedData[i] && deflatedData[i + 1]) {
+            bits[shift--] = 1;
+        } else if (deflatedData[i] && !deflatedData[i + 1]) {
+            bits[shift--] = 0;
+        }
+    }
+
+    bits[29] = 0;
+
+    value = static_cast<uint32_t>(bits.to_ulong());
+    return true;
+}
+
+static bool legacyDataToKey(const std::vector<unsigned int>& data, uint32_t& value)
+{
+    if (data.size() < 5) {
+        return false;
+    }
+
+    return legacyDataToKeyNEC(data, value) || legacyDataToKeyRC5(data, value);
+}
+
+static std::vector<unsigned int> necFrame(uint32_t value)
+{
+    std::vector<unsigned int> data = {9000, 4500};
+    for (int i = 31; i >= 0; i--) {
+        data.push_back(563);
+        data.push_back(((value >> i) & 1U) ? 1687 : 563);
+    }
+
+    data.push_back(563);
+    return data;
+}
+
+static std::vector<unsigned int> rc5Frame(uint32_t value)
+{
+    // Half-bit levels, minus the leading space nobody sees
+    std::vector<bool> levels;
+    for (int i = 13; i >= 0; i--) {
+        bool one = (value >> i) & 1U;
+        levels.push_back(!one);
+        levels.push_back(one);
+    }
+
+    std::vector<unsigned int> data;
+    size_t i = 1;
+    while (i < levels.size()) {
+        size_t run = 1;
+        while (i + run < levels.size() && levels[i + run] == levels[i]) {
+            run++;
+        }
+
+        if (!levels[i] && i + run == levels.size()) {
+            break;
+        }
+
+        data.push_back(run * 889);
+        i += run;
+    }
+
+    return data;
+}
+
+BENCHMARK(decode)
+{
+    std::vector<std::vector<unsigned int> > nec, rc5;
+    for (uint32_t i = 0; i < 64; i++) {
+        nec.push_back(necFrame(0x00FF0000U | (i << 8) | (~i & 0xFFU)));
+        rc5.push_back(rc5Frame(0x3000U | (i * 37 & 0x7FFU)));
+    }
+
+    IRDecoder decoder;
+    auto table = [&decoder](const std::vector<unsigned int>& frame) {
+        IRCode code;
+        decoder.reset();
+        for (size_t i = 0; i < frame.size(); i++) {
+            if (decoder.push(i % 2 == 0, frame[i], code)) {
+                return true;
+            }
+        }
+
+        return decoder.finish(code);
+    };
+
+    auto legacy = [](const std::vector<unsigned int>& frame) {
+        uint32_t value;
+        return legacyDataToKey(frame, value);
+    };
+
+    const uint64_t ops = 1000000;
+    bench::measure("NEC frame, legacy", ops, [&](uint64_t i) { bench::keep(legacy(nec[i % nec.size()])); });
+    bench::measure("NEC frame, table", ops, [&](uint64_t i) { bench::keep(table(nec[i % nec.size()])); });
+    bench::measure("RC5 frame, legacy", ops, [&](uint64_t i) { bench::keep(legacy(rc5[i % rc5.size()])); });
+    bench::measure("RC5 frame, table", ops, [&](uint64_t i) { bench::keep(table(rc5[i % rc5.size()])); });
+}
@@ -0,0 +1,40 @@
+// Loading the keys from the text key file against mapping a compiled keymap
+
+#include <cstdio>
+#include <unistd.h>
+
+#include "bench.h"
+#include "keymap.h"
+
+BENCHMARK(keymap)
+{
+    const char* keys = CECFORWARDER_SOURCE_DIR "/files/dilog.file";
+
+    char path[] = "/tmp/cecforwarder-bench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        perror("mkstemp");
+        return;
+    }
+
+    close(fd);
+
+    Keymap compiled;
+    if (!compiled.build(keys) || !compiled.write(path)) {
+        unlink(path);
+        return;
+    }
+
+    const uint64_t ops = 2000;
+    bench::measure("build from key file", ops, [&](uint64_t i) {
+        Keymap keymap;
+        bench::keep(keymap.build(keys));
+    });
+
+    bench::measure("map compiled", ops, [&](uint64_t i) {
+        Keymap keymap;
+        bench::keep(keymap.map(path, keys));
+    });
+
+    unlink(path);
+}
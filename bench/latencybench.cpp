@@ -0,0 +1,24 @@
+// What it costs to keep the latency histograms enabled
+
+#include "bench.h"
+#include "latency.h"
+
+BENCHMARK(latency)
+{
+    const uint64_t ops = 10000000;
+    static LatencyHistogram histogram;
+
+    bench::measure("now", ops, [&](uint64_t i) {
+        bench::keep(Latency::now());
+    });
+
+    bench::measure("histogram record", ops, [&](uint64_t i) {
+        histogram.record(i * 2654435761U % 100000000);
+    });
+
+    bench::measure("timestamp and record", ops, [&](uint64_t i) {
+        Latency::record(Latency::STAGE_LOOKUP, Latency::now());
+    });
+
+    bench::keep(histogram.percentile(0.99));
+}
@@ -0,0 +1,88 @@
+// Cost of mapping a received code back to its key, against the linear
+// scan over the key map that LircPP::receive used to do.
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.h"
+#include "codeindex.h"
+
+BENCHMARK(lookup)
+{
+    for (size_t count: {40, 400, 4000}) {
+        std::unordered_map<KeyName, IRCode> data;
+        CodeIndex index;
+        std::vector<IRCode> codes;
+
+        // Several remotes' worth of codes, spread over the key names. Like
+        // real remotes they share an address and count up the command, so
+        // codes mostly differ in a few middle bits.
+        for (size_t i = 0; i < count; i++) {
+            uint32_t address = (i / 2) / 256, command = (i / 2) % 256;
+            IRCode code;
+            if (i % 2) {
+                code = IRCode {&IRProtocol::NEC, address << 24 | (~address & 0xFF) << 16 | command << 8 | (~command & 0xFF), false};
+            } else {
+                code = IRCode {&IRProtocol::RC6, 1U << 20 | address << 8 | command, false};
+            }
+
+            KeyName key(static_cast<KeyName::Value>(i % (KeyName::KEY_COUNT)));
+
+            if (i < KeyName::KEY_COUNT) {
+                data[key] = code;
+            }
+
+            index.insert(code, key);
+            codes.push_back(code);
+        }
+
+        std::string suffix = ", " + std::to_string(count) + " codes";
+        const uint64_t ops = 1000000;
+
+        bench::measure("index" + suffix, ops, [&](uint64_t i) {
+            bench::keep(index.find(codes[(i * 7919) % codes.size()]));
+        });
+
+        // The map only holds one code per key, so scale its scan up to
+        // what a linear search over every code would cost
+        uint64_t scans = count / data.size();
+        bench::measure("linear scan" + suffix, ops, [&](uint64_t i) {
+            const IRCode& code = codes[(i * 7919) % codes.size()];
+            for (uint64_t s = 0; s < scans; s++) {
+                for (auto entry: data) {
+                    if (entry.second.protocol == code.protocol && entry.second.value == code.value) {
+                        bench::keep(entry.first);
+                        break;
+                    }
+                }
+            }
+        });
+
+        bench::measure("miss" + suffix, ops, [&](uint64_t i) {
+            IRCode code = {&IRProtocol::SIRC12, static_cast<uint32_t>(i), false};
+            bench::keep(index.find(code));
+        });
+    }
+}
+
+BENCHMARK(keyname)
+{
+    const uint64_t ops = 1000000;
+    std::vector<std::string> names;
+    for (int i = 0; i < KeyName::KEY_COUNT; i++) {
+        names.push_back(KeyName(static_cast<KeyName::Value>(i)).name());
+    }
+
+    bench::measure("name", ops, [&](uint64_t i) {
+        bench::keep(KeyName(static_cast<KeyName::Value>(i % KeyName::KEY_COUNT)).name());
+    });
+
+    bench::measure("parse", ops, [&](uint64_t i) {
+        bench::keep(KeyName(names[i % names.size()]));
+    });
+
+    bench::measure("parse miss", ops, [&](uint64_t i) {
+        bench::keep(KeyName("KEY_INFO"));
+    });
+}
@@ -0,0 +1,71 @@
+// Preparing IR frames for transmission, and decoding the frames of a real
+// remote through LircPP
+
+#include <iostream>
+#include <vector>
+
+#include "bench.h"
+#include "irencoder.h"
+#include "lircpp.h"
+
+BENCHMARK(send)
+{
+    const uint64_t ops = 1000000;
+
+    std::vector<unsigned int> waveform;
+    bench::measure("NEC waveform, encode", ops, [&](uint64_t i) {
+        IRCode code = {&IRProtocol::NEC, static_cast<uint32_t>(0x0076827DU ^ ((i & 0xFFU) << 8)), false};
+        IREncoder::encode(code, waveform);
+        bench::keep(waveform.size());
+    });
+
+    std::vector<unsigned int> repeat;
+    bench::measure("NEC repeat waveform, encode", ops, [&](uint64_t i) {
+        IREncoder::encodeRepeat(&IRProtocol::NEC, repeat);
+        bench::keep(repeat.size());
+    });
+
+    LircPP lirc(CECFORWARDER_SOURCE_DIR "/files/dilog.file");
+    KeyTable::RemotePtr keys = lirc.keys();
+    if (keys == nullptr) {
+        return;
+    }
+
+    bench::measure("NEC waveform, prepared", ops, [&](uint64_t i) {
+        bench::keep(keys->waveform(static_cast<KeyName::Value>(i % KeyName::KEY_COUNT)));
+    });
+
+    // What a CEC key press pays to look its waveform up
+    bench::measure("NEC waveform, snapshot and lookup", ops, [&](uint64_t i) {
+        KeyTable::RemotePtr snapshot = lirc.keys();
+        bench::keep(snapshot->waveform(static_cast<KeyName::Value>(i % KeyName::KEY_COUNT)));
+    });
+}
+
+BENCHMARK(receive)
+{
+    LircPP lirc(CECFORWARDER_SOURCE_DIR "/files/dilog.file");
+    KeyTable::RemotePtr keys = lirc.keys();
+    if (keys == nullptr) {
+        return;
+    }
+
+    std::vector<std::vector<unsigned int> > frames;
+    for (int i = 0; i < KeyName::KEY_COUNT; i++) {
+        const IRWaveform* waveform = keys->waveform(static_cast<KeyName::Value>(i));
+        if (waveform != nullptr) {
+            frames.push_back(std::vector<unsigned int>(waveform->data, waveform->data + waveform->size));
+        }
+    }
+
+    if (frames.empty()) {
+        std::cerr << "No frames in " CECFORWARDER_SOURCE_DIR "/files/dilog.file\n";
+        return;
+    }
+
+    const uint64_t ops = 1000000;
+    bench::measure("dataToKey, " + std::to_string(frames.size()) + " dilog.file frames", ops, [&](uint64_t i) {
+        IRCode code;
+        bench::keep(lirc.dataToKey(frames[i % frames.size()], code));
+    });
+}
@@ -0,0 +1,209 @@
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "capture.h"
+#include "log.h"
+
+const char Capture::MAGIC[8] = {'I', 'R', 'C', 'A', 'P', 'v', '1', '\n'};
+
+CaptureWriter::CaptureWriter()
+    : mFd(-1)
+    , mLastTime(0)
+{
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+bool CaptureWriter::open(const std::string& path)
+{
+    close();
+
+    mFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mFd == -1) {
+        LOG(ERROR, "Failed opening capture %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    mLastTime = 0;
+    mBuf.assign(Capture::MAGIC, Capture::MAGIC + sizeof(Capture::MAGIC));
+    return flush();
+}
+
+void CaptureWriter::close()
+{
+    if (mFd != -1) {
+        flush();
+        ::close(mFd);
+        mFd = -1;
+    }
+}
+
+void CaptureWriter::write(uint32_t sample, uint64_t timeUs)
+{
+    if (mFd == -1) {
+        return;
+    }
+
+    // The first record is relative to zero, so it holds the start time
+    varint(timeUs - mLastTime);
+    varint((static_cast<uint64_t>(sample & 0x00FFFFFFU) << 3) | ((sample >> 24) & 7U));
+    mLastTime = timeUs;
+
+    if (mBuf.size() >= 4096) {
+        flush();
+    }
+}
+
+bool CaptureWriter::flush()
+{
+    size_t done = 0;
+    while (done < mBuf.size()) {
+        ssize_t ret = ::write(mFd, mBuf.data() + done, mBuf.size() - done);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (ret <= 0) {
+            LOG(ERROR, "Failed writing capture: %s", strerror(errno));
+            mBuf.clear();
+            return false;
+        }
+
+        done += ret;
+    }
+
+    mBuf.clear();
+    return true;
+}
+
+void CaptureWriter::varint(uint64_t value)
+{
+    while (value >= 0x80) {
+        mBuf.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+
+    mBuf.push_back(static_cast<uint8_t>(value));
+}
+
+CaptureReader::CaptureReader()
+    : mFd(-1)
+    , mTime(0)
+    , mPos(0)
+    , mLen(0)
+{
+}
+
+CaptureReader::~CaptureReader()
+{
+    close();
+}
+
+bool CaptureReader::open(const std::string& path)
+{
+    int fd = (path == "-") ? dup(STDIN_FILENO) : ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        LOG(ERROR, "Failed opening capture %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    return attach(fd);
+}
+
+bool CaptureReader::attach(int fd)
+{
+    close();
+
+    mFd = fd;
+    mTime = 0;
+    if (!checkMagic()) {
+        LOG(ERROR, "Not an IR capture");
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void CaptureReader::close()
+{
+    if (mFd != -1) {
+        ::close(mFd);
+        mFd = -1;
+    }
+
+    mPos = mLen = 0;
+}
+
+bool CaptureReader::checkMagic()
+{
+    for (size_t i = 0; i < sizeof(Capture::MAGIC); i++) {
+        uint8_t c;
+        if (!byte(c) || c != static_cast<uint8_t>(Capture::MAGIC[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CaptureReader::next(uint32_t& sample, uint64_t& timeUs)
+{
+    uint64_t delta, value;
+    if (!varint(delta) || !varint(value)) {
+        return false;
+    }
+
+    mTime += delta;
+    timeUs = mTime;
+    sample = static_cast<uint32_t>(((value & 7U) << 24) | ((value >> 3) & 0x00FFFFFFU));
+    return true;
+}
+
+bool CaptureReader::varint(uint64_t& value)
+{
+    value = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        uint8_t c;
+        if (!byte(c)) {
+            return false;
+        }
+
+        value |= static_cast<uint64_t>(c & 0x7F) << shift;
+        if ((c & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool CaptureReader::byte(uint8_t& value)
+{
+    if (mPos == mLen) {
+        if (mFd == -1) {
+            return false;
+        }
+
+        ssize_t ret;
+        do {
+            ret = read(mFd, mBuf, sizeof(mBuf));
+        } while (ret < 0 && errno == EINTR);
+
+        if (ret <= 0) {
+            return false;
+        }
+
+        mPos = 0;
+        mLen = ret;
+    }
+
+    value = mBuf[mPos++];
+    return true;
+}
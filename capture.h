@@ -0,0 +1,64 @@
+#ifndef CECFORWARDER_CAPTURE_H
+#define CECFORWARDER_CAPTURE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Raw mode2 samples as they came off the receiver, with the time each
+// was read. The file starts with an 8 byte magic, followed by one record
+// per sample: the microseconds since the previous record and the sample,
+// (duration << 3) | mode2 type, each as an unsigned LEB128 varint. A
+// typical record takes three to four bytes.
+namespace Capture {
+    extern const char MAGIC[8];
+}
+
+class CaptureWriter {
+public:
+    CaptureWriter();
+    ~CaptureWriter();
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return mFd != -1; }
+
+    // Samples read together share a timestamp, in microseconds on any
+    // monotonic clock
+    void write(uint32_t sample, uint64_t timeUs);
+    bool flush();
+
+private:
+    void varint(uint64_t value);
+
+    int mFd;
+    uint64_t mLastTime;
+    std::vector<uint8_t> mBuf;
+};
+
+class CaptureReader {
+public:
+    CaptureReader();
+    ~CaptureReader();
+
+    // "-" reads standard input
+    bool open(const std::string& path);
+    // Takes ownership of fd, which can be anything read() works on
+    bool attach(int fd);
+    void close();
+
+    // Returns false at the end of the capture or on a malformed record
+    bool next(uint32_t& sample, uint64_t& timeUs);
+
+private:
+    bool checkMagic();
+    bool varint(uint64_t& value);
+    bool byte(uint8_t& value);
+
+    int mFd;
+    uint64_t mTime;
+    uint8_t mBuf[4096];
+    size_t mPos, mLen;
+};
+
+#endif // CECFORWARDER_CAPTURE_H
@@ -0,0 +1,87 @@
+#include <libcec/cecloader.h>
+
+#include "cecadapter.h"
+#include "log.h"
+
+LibCecAdapter::LibCecAdapter()
+    : mAdapter(nullptr)
+{
+}
+
+LibCecAdapter::~LibCecAdapter()
+{
+    if (mAdapter != nullptr) {
+        UnloadLibCec(mAdapter);
+    }
+}
+
+bool LibCecAdapter::initialise(CEC::libcec_configuration& config)
+{
+    mAdapter = LibCecInitialise(&config);
+    if (mAdapter == nullptr) {
+        LOG(ERROR, "Failed initialising cec!");
+        return false;
+    }
+
+    mAdapter->InitVideoStandalone();
+    return true;
+}
+
+bool LibCecAdapter::open()
+{
+    mAdapter->Close();
+
+    CEC::cec_adapter_descriptor devices[10];
+    if (mAdapter->DetectAdapters(devices, 10, NULL, true) <= 0) {
+        LOG(ERROR, "No adapters found");
+        return false;
+    }
+
+    if (!mAdapter->Open(devices[0].strComName)) {
+        LOG(ERROR, "Failed opening adapter %s", devices[0].strComName);
+        return false;
+    }
+
+    LOG(NOTICE, "Opened adapter %s", devices[0].strComName);
+    return true;
+}
+
+void LibCecAdapter::close()
+{
+    mAdapter->Close();
+}
+
+CEC::cec_logical_address LibCecAdapter::getActiveSource()
+{
+    return mAdapter->GetActiveSource();
+}
+
+uint16_t LibCecAdapter::getDevicePhysicalAddress(CEC::cec_logical_address address)
+{
+    return mAdapter->GetDevicePhysicalAddress(address);
+}
+
+bool LibCecAdapter::powerOnDevices(CEC::cec_logical_address address)
+{
+    return mAdapter->PowerOnDevices(address);
+}
+
+bool LibCecAdapter::standbyDevices(CEC::cec_logical_address address)
+{
+    return mAdapter->StandbyDevices(address);
+}
+
+bool LibCecAdapter::setActiveSource()
+{
+    return mAdapter->SetActiveSource();
+}
+
+bool LibCecAdapter::sendKeypress(CEC::cec_logical_address address, CEC::cec_user_control_code key, bool wait)
+{
+    return mAdapter->SendKeypress(address, key, wait);
+}
+
+bool LibCecAdapter::sendKeyRelease(CEC::cec_logical_address address, bool wait)
+{
+    return mAdapter->SendKeyRelease(address, wait);
+}
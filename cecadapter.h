@@ -0,0 +1,52 @@
+#ifndef CECFORWARDER_CECADAPTER_H
+#define CECFORWARDER_CECADAPTER_H
+
+#include <libcec/cec.h>
+
+// The part of libCEC's ICECAdapter the forwarder uses, so something other
+// than a real adapter can stand in for it
+class CecAdapter {
+public:
+    virtual ~CecAdapter() {}
+
+    // Get ready to deliver events to config.callbacks; false if the
+    // backend is unusable
+    virtual bool initialise(CEC::libcec_configuration& config) = 0;
+
+    // Find and open the adapter, and close it again
+    virtual bool open() = 0;
+    virtual void close() = 0;
+
+    virtual CEC::cec_logical_address getActiveSource() = 0;
+    virtual uint16_t getDevicePhysicalAddress(CEC::cec_logical_address address) = 0;
+    virtual bool powerOnDevices(CEC::cec_logical_address address) = 0;
+    virtual bool standbyDevices(CEC::cec_logical_address address) = 0;
+    virtual bool setActiveSource() = 0;
+    virtual bool sendKeypress(CEC::cec_logical_address address, CEC::cec_user_control_code key, bool wait) = 0;
+    virtual bool sendKeyRelease(CEC::cec_logical_address address, bool wait) = 0;
+};
+
+// A real adapter through libCEC
+class LibCecAdapter : public CecAdapter {
+public:
+    LibCecAdapter();
+    ~LibCecAdapter();
+
+    bool initialise(CEC::libcec_configuration& config) override;
+
+    bool open() override;
+    void close() override;
+
+    CEC::cec_logical_address getActiveSource() override;
+    uint16_t getDevicePhysicalAddress(CEC::cec_logical_address address) override;
+    bool powerOnDevices(CEC::cec_logical_address address) override;
+    bool standbyDevices(CEC::cec_logical_address address) override;
+    bool setActiveSource() override;
+    bool sendKeypress(CEC::cec_logical_address address, CEC::cec_user_control_code key, bool wait) override;
+    bool sendKeyRelease(CEC::cec_logical_address address, bool wait) override;
+
+private:
+    CEC::ICECAdapter* mAdapter;
+};
+
+#endif // CECFORWARDER_CECADAPTER_H
@@ -1,21 +1,101 @@
-#include <iostream>
-#include <sys/time.h>
 #include "cecforwarder.h"
-#include <libcec/cecloader.h>
+#include "latency.h"
+#include "log.h"
+#include "metrics.h"
 
 using namespace CEC;
 
-CecForwarder::CecForwarder(const std::string& baseDir, const std::string& keyname, const std::string& cecname, bool verbose)
-    : mVerbose(verbose)
-    , mRepeatDelay(850)
-    , mRepeatRate(50)
-    , mAdapterOpen(false)
-    , mAdapter(nullptr)
-    , mLirc(baseDir + "/keys/" + keyname)
+CecForwarder::Bindings::Bindings(const KeyTable::RemotePtr& keys)
+    : mKeys(keys)
+{
+    mCecKeys.fill(KeyName());
+
+    // Switch to the second playback device and open its menu, powering
+    // everything on first unless it is already the active source
+    addAction("KEY_HOME", "poweron 15 unless 8; key 8 0x6D; waitsource 8 10000; key 8 0x09");
+}
+
+void CecForwarder::Bindings::addKey(int keycode, const char* name)
+{
+    if (keycode < 0 || keycode >= static_cast<int>(mCecKeys.size())) {
+        LOG(WARNING, "Invalid CEC key code %d for %s", keycode, name);
+        return;
+    }
+
+    KeyName key(name);
+    if (key.value() == KeyName::KEY_INVALID) {
+        LOG(WARNING, "No IR code for %s, ignoring CEC key code %d", name, keycode);
+        return;
+    }
+
+    addKey(keycode, key);
+}
+
+void CecForwarder::Bindings::addKey(int keycode, const KeyName& key)
+{
+    if (mKeys == nullptr || mKeys->waveform(key) == nullptr) {
+        LOG(WARNING, "No IR code for %s, ignoring CEC key code %d", key.name(), keycode);
+        return;
+    }
+
+    mCecKeys[keycode] = key;
+}
+
+bool CecForwarder::Bindings::loadCompiledKeys(const std::string& configPath)
+{
+    const int32_t* cecKeys = (mKeys != nullptr) ? mKeys->keymap().cecKeys() : nullptr;
+    if (cecKeys == nullptr || mKeys->keymap().configPath() != configPath) {
+        return false;
+    }
+
+    for (size_t i = 0; i < Keymap::CEC_CODES; i++) {
+        if (cecKeys[i] != KeyName::KEY_INVALID) {
+            addKey(i, KeyName(static_cast<KeyName::Value>(cecKeys[i])));
+        }
+    }
+
+    return true;
+}
+
+bool CecForwarder::Bindings::addAction(const std::string& key, const std::string& steps)
 {
-    memset(&mKeyRepeat, 0, sizeof(KeyRepeat));
-    mKeyRepeat.keycode = CEC_USER_CONTROL_CODE_UNKNOWN;
+    KeyName name(key);
+    if (name.value() == KeyName::KEY_INVALID) {
+        LOG(WARNING, "Unknown key %s for action", key.c_str());
+        return false;
+    }
+
+    CecMacro macro;
+    if (!CecMacroEngine::parse(steps, macro)) {
+        LOG(WARNING, "Invalid action for %s", key.c_str());
+        return false;
+    }
 
+    const CecMacroStep& first = macro.front();
+    IRAction& action = mIRActions[name.value()];
+    action.direct = macro.size() == 1 && first.type != CecMacroStep::STEP_WAIT_SOURCE &&
+        first.type != CecMacroStep::STEP_DELAY && first.unless == CECDEVICE_UNKNOWN;
+    action.macro.swap(macro);
+    return true;
+}
+
+const CecMacro* CecForwarder::Bindings::action(const KeyName& key) const
+{
+    if (key.value() == KeyName::KEY_INVALID || mIRActions[key.value()].macro.empty()) {
+        return nullptr;
+    }
+
+    return &mIRActions[key.value()].macro;
+}
+
+CecForwarder::CecForwarder(const BindingsPtr& bindings, const std::string& cecname, CecAdapter* adapter)
+    : mBindings(bindings)
+    , mAdapterOpen(false)
+    , mAdapter((adapter != nullptr) ? adapter : new LibCecAdapter())
+    , mLirc(bindings->keys())
+    , mTransmitter(mLirc)
+    , mRepeater(mTransmitter)
+{
     mCecCallbacks.Clear();
     mCecConfig.Clear();
 
@@ -33,26 +113,28 @@ CecForwarder::CecForwarder(const std::string& baseDir, const std::string& keynam
     mCecConfig.wakeDevices.Set(CEC::CECDEVICE_TV);
     mCecConfig.wakeDevices.Set(CEC::CECDEVICE_PLAYBACKDEVICE2);
 
-    mAdapter = LibCecInitialise(&mCecConfig);
-    if (mAdapter == nullptr) {
-        std::cerr << "Failed initialising cec!\n";
+    if (!mAdapter->initialise(mCecConfig)) {
+        mAdapter.reset();
         return;
     }
 
-    mAdapter->InitVideoStandalone();
+    mMacroEngine.setAdapter(mAdapter.get());
+
+    mTransmitter.CreateThread(false);
 }
 
 CecForwarder::~CecForwarder()
 {
-    mAdapter = nullptr;
 }
 
 void CecForwarder::close()
 {
+    mTransmitter.cancel();
+    mTransmitter.StopThread();
+
     if (mAdapter != nullptr) {
-        mAdapter->Close();
+        mAdapter->close();
         mAdapterOpen = false;
-        UnloadLibCec(mAdapter);
     }
 }
 
@@ -66,136 +148,155 @@ bool CecForwarder::ensureOpen()
         return true;
     }
 
-    std::cerr << "Need to open adapter\n";
+    LOG(ERROR, "Need to open adapter");
 
-    mAdapter->Close();
-
-    bool ret = false;
-    CEC::cec_adapter_descriptor devices[10];
-    if (mAdapter->DetectAdapters(devices, 10, NULL, true) > 0) {
-        ret = mAdapter->Open(devices[0].strComName);
-        if (ret) {
-            std::cerr << "Opened adapter " << devices[0].strComName << "\n";
-        } else {
-            std::cerr << "Failed opening adapter " << devices[0].strComName << "\n";
-        }
+    bool ret = mAdapter->open();
+    if (ret) {
+        // From here on macros follow the active source from the bus
+        mMacroEngine.setActiveSource(mAdapter->getActiveSource());
+        Metrics::adapterOpened();
     } else {
-        std::cerr << "No adapters found\n";
+        Metrics::adapterOpenFailed();
     }
 
     mAdapterOpen = ret;
     return ret;
 }
 
-void CecForwarder::addKey(int keycode, const std::string& name)
+void CecForwarder::setBindings(const BindingsPtr& bindings)
 {
-    mKeys[keycode] = name;
+    // The keys first, so a press that finds the new bindings sends from
+    // them too
+    mLirc.setKeys(bindings->keys());
+    std::atomic_store(&mBindings, bindings);
 }
 
-void CecForwarder::setRepeat(int delay, int rate)
+CecForwarder::BindingsPtr CecForwarder::bindings() const
 {
-    mRepeatDelay = (delay > 0) ? delay : mRepeatDelay;
-    mRepeatRate = (rate > 0) ? rate : mRepeatRate;
+    return std::atomic_load(&mBindings);
 }
 
-void CecForwarder::onReceive(const KeyName& key)
+void CecForwarder::setRepeat(int delay, int rate)
 {
-    std::cerr << "onReceive " << key.name() << "\n";
+    mRepeater.setRepeat(delay > 0 ? delay : 0, rate > 0 ? rate : 0);
+}
 
-    switch (key.value()) {
-    case KeyName::KEY_HOME:
-        if (mAdapter->GetActiveSource() != CEC::CECDEVICE_PLAYBACKDEVICE2) {
-            mAdapter->PowerOnDevices(CEC::CECDEVICE_BROADCAST);
-        }
+void CecForwarder::setTransmitQueue(size_t capacity, IRTransmitter::Policy policy)
+{
+    mTransmitter.configure(capacity, policy);
+}
 
-        mAdapter->SendKeypress(CEC::CECDEVICE_PLAYBACKDEVICE2, CEC::CEC_USER_CONTROL_CODE_POWER_ON_FUNCTION, true);
-        mAdapter->SendKeyRelease(CEC::CECDEVICE_PLAYBACKDEVICE2, true);
+IRTransmitter::Stats CecForwarder::transmitStats()
+{
+    return mTransmitter.stats();
+}
 
-        // Wait at max 10 seconds for source switch
-        uint32_t i = 0;
-        while (mAdapter->GetActiveSource() != CEC::CECDEVICE_PLAYBACKDEVICE2 && i < 100) {
-            std::cerr << "Active source " << mAdapter->GetActiveSource() << "\n";
-            usleep(100);
-            i++;
-        }
+bool CecForwarder::setTransmitFile(const std::string& path)
+{
+    return mLirc.setTransmitFile(path);
+}
 
-        mAdapter->SendKeypress(CEC::CECDEVICE_PLAYBACKDEVICE2, CEC::CEC_USER_CONTROL_CODE_ROOT_MENU, true);
-        mAdapter->SendKeyRelease(CEC::CECDEVICE_PLAYBACKDEVICE2, true);
+bool CecForwarder::waitTransmitIdle(int timeoutMs)
+{
+    return mTransmitter.waitIdle(timeoutMs);
+}
 
-        break;
-    }
+void CecForwarder::attach(EventLoop& loop)
+{
+    loop.add(mRepeater.fd(), [this] { mRepeater.expired(); });
+    mMacroEngine.attach(loop);
 }
 
-void CecForwarder::cecKeyPress(const CEC::cec_keypress* key)
+void CecForwarder::onReceive(const KeyName& key, LircPP::Event event)
 {
-    if (mVerbose) {
-        std::cout << "cecKeyPress " << key->keycode << "\n";
+    if (key.value() == KeyName::KEY_INVALID) {
+        return;
     }
 
-    if(key->duration != 0) {
+    BindingsPtr bindings = this->bindings();
+    const Bindings::IRAction& action = bindings->mIRActions[key.value()];
+    if (action.macro.empty()) {
         return;
     }
 
-    timeval tv;
-    gettimeofday(&tv, NULL);
+    LOG(DEBUG, "onReceive %s %d", key.name(), event);
 
-    uint64_t timenow = (tv.tv_sec * 1000) + (tv.tv_usec / 1000UL);
+    if (!action.direct) {
+        if (event == LircPP::EVENT_PRESS) {
+            // Shares ownership of the bindings, which the macro lives in
+            mMacroEngine.start(CecMacroPtr(bindings, &action.macro));
+        }
 
-    if(mKeyRepeat.keycode == key->keycode) {
-        uint64_t diff = timenow - mKeyRepeat.lastpress;
+        return;
+    }
 
-        int repeatDelay = (mKeyRepeat.repeatstart == 0) ? mRepeatDelay : mRepeatRate;
-        if(diff < repeatDelay) {
-            return;
-        }
+    // A held key keeps being pressed, as the TV would
+    const CecMacroStep& step = action.macro.front();
+    if (step.type == CecMacroStep::STEP_KEY) {
+        mMacroEngine.send(step, event == LircPP::EVENT_RELEASE);
+    } else if (event == LircPP::EVENT_PRESS) {
+        mMacroEngine.send(step);
+    }
+}
 
-        std::cerr << "Key repeat " <<  key->keycode << ", diff " << diff << ", delay " << repeatDelay << "\n";
-        if (mKeyRepeat.repeatstart == 0) {
-            mKeyRepeat.repeatstart = timenow;
-        }
+void CecForwarder::cecKeyPress(const CEC::cec_keypress* key, uint64_t received)
+{
+    LOG(DEBUG, "cecKeyPress %d", key->keycode);
+
+    // libCEC reports the release with how long the key was held
+    if(key->duration != 0) {
+        mRepeater.release();
+        return;
     }
 
-    mKeyRepeat.keycode = key->keycode;
-    mKeyRepeat.lastpress = timenow;
+    BindingsPtr bindings = this->bindings();
+    KeyName name = bindings->keyFor(key->keycode);
+    const KeyTable::RemotePtr& keys = bindings->keys();
+    const IRWaveform* waveform = (keys != nullptr) ? keys->waveform(name) : nullptr;
+    if (waveform == nullptr) {
+        mRepeater.release();
+        return;
+    }
 
-    if (mKeys.count(key->keycode) > 0) {
-        std::string keyName = mKeys.at(key->keycode);
-        std::cerr << "Key " << keyName << "\n";
-        mLirc.send(keyName);
+    // Presses the TV resends while the key is held only keep the
+    // repeat going
+    if (mRepeater.press(name, keys)) {
+        LOG(INFO, "Key %s", name.name());
+        mTransmitter.queue(name, *waveform, keys, received);
+        Latency::record(Latency::STAGE_CEC_TO_QUEUE, received);
     }
 }
 
-void CecForwarder::cecCommand(const CEC::cec_command* command)
+void CecForwarder::cecCommand(const CEC::cec_command* command, uint64_t received)
 {
-    if (mVerbose) {
-        std::cout << "cecCommand " << command->opcode << "\n";
-    }
+    LOG(DEBUG, "cecCommand %d", command->opcode);
+
+    Metrics::cecCommand(command->opcode);
+    mMacroEngine.onCommand(*command);
 
     switch(command->opcode) {
     case CEC_OPCODE_USER_CONTROL_PRESSED:
         if(command->parameters.size > 0) {
             cec_keypress key = {(cec_user_control_code) command->parameters.data[0], 0};
-            cecKeyPress(&key);
+            cecKeyPress(&key, received);
         }
 
         break;
     case CEC_OPCODE_USER_CONTROL_RELEASE:
-        memset(&mKeyRepeat, 0, sizeof(KeyRepeat));
-        mKeyRepeat.keycode = CEC_USER_CONTROL_CODE_UNKNOWN;
+        mRepeater.release();
         break;
     }
 }
 
 void CecForwarder::cecAlert(const CEC::libcec_alert type, const CEC::libcec_parameter param)
 {
-    if (mVerbose) {
-        std::cout << "cecAlert " << type << "\n";
-    }
+    LOG(DEBUG, "cecAlert %d", type);
 
     switch (type) {
     case CEC_ALERT_CONNECTION_LOST:
-        std::cerr << "Lost connection, closing adapter\n";
+        LOG(WARNING, "Lost connection, closing adapter");
         mAdapterOpen = false;
+        mConnectionLost.notify();
         break;
     default:
         break;
@@ -204,30 +305,43 @@ void CecForwarder::cecAlert(const CEC::libcec_alert type, const CEC::libcec_para
 
 void CecForwarder::cecLogMessage(const CEC::cec_log_message* message)
 {
-    if (!mVerbose) {
-        return;
+    Log::Level level;
+    switch (message->level) {
+    case CEC::CEC_LOG_ERROR:
+        level = Log::LEVEL_ERROR;
+        break;
+    case CEC::CEC_LOG_WARNING:
+        level = Log::LEVEL_WARNING;
+        break;
+    case CEC::CEC_LOG_NOTICE:
+        level = Log::LEVEL_NOTICE;
+        break;
+    case CEC::CEC_LOG_DEBUG:
+        level = Log::LEVEL_DEBUG;
+        break;
+    default:
+        level = Log::LEVEL_TRAFFIC;
+        break;
     }
 
-    static std::unordered_map<CEC::cec_log_level, std::string> sLogLevels = {
-        {CEC::CEC_LOG_ERROR, "Error"},
-        {CEC::CEC_LOG_WARNING, "Warning"},
-        {CEC::CEC_LOG_NOTICE, "Notice"},
-        {CEC::CEC_LOG_TRAFFIC, "Traffic"},
-        {CEC::CEC_LOG_DEBUG, "Debug"}
-    };
+    // libCEC's errors are only of interest when debugging it
+    if (level < Log::LEVEL_DEBUG) {
+        level = Log::LEVEL_DEBUG;
+    }
 
-    std::string level = (sLogLevels.find(message->level) != sLogLevels.end()) ? sLogLevels.at(message->level) : "Unknown";
-    std::cout << level << " [" << message->time << "]: " << message->message << "\n";
+    if (Log::enabled(level)) {
+        Log::write(level, "libCEC [%lld]: %s", static_cast<long long>(message->time), message->message);
+    }
 }
 
 void CecForwarder::HandleCecKeyPress(void *cbParam, const CEC::cec_keypress* key)
 {
-    static_cast<CecForwarder*>(cbParam)->cecKeyPress(key);
+    static_cast<CecForwarder*>(cbParam)->cecKeyPress(key, Latency::now());
 }
 
 void CecForwarder::HandleCecCommand(void *cbParam, const CEC::cec_command* command)
 {
-    static_cast<CecForwarder*>(cbParam)->cecCommand(command);
+    static_cast<CecForwarder*>(cbParam)->cecCommand(command, Latency::now());
 }
 
 void CecForwarder::HandleCecAlert(void *cbParam, const CEC::libcec_alert type, const CEC::libcec_parameter param)
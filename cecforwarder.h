@@ -1,34 +1,110 @@
+#ifndef CECFORWARDER_CECFORWARDER_H
+#define CECFORWARDER_CECFORWARDER_H
+
+#include <array>
 #include <atomic>
-#include <unordered_map>
+#include <memory>
 #include <libcec/cec.h>
 
+#include "cecadapter.h"
+#include "cecmacro.h"
 #include "config.h"
+#include "eventloop.h"
 #include "irreader.h"
+#include "irtransmitter.h"
+#include "keyrepeater.h"
+#include "keytable.h"
 #include "lircpp.h"
 
-struct KeyRepeat {
-    CEC::cec_user_control_code keycode;
-    uint64_t lastpress;
-    uint64_t repeatstart;
-};
-
 class CecForwarder : public IRReader::Callback
 {
 public:
-    CecForwarder(const std::string& baseDir, const std::string& keyname, const std::string& cecname, bool verbose);
+    // What keys turn into either way: the IR key sent for a CEC key, and
+    // what an IR key does on the bus. Filled in before it is handed to
+    // setBindings() and immutable from then on, so that a reload builds a
+    // new set rather than changing the one in use.
+    class Bindings
+    {
+    public:
+        // The IR keys are sent from keys. KEY_HOME gets its default
+        // action, which addAction() can override.
+        Bindings(const KeyTable::RemotePtr& keys);
+
+        const KeyTable::RemotePtr& keys() const { return mKeys; }
+
+        void addKey(int keycode, const char* name);
+        void addKey(int keycode, const KeyName& key);
+        // Take the CEC key table from the compiled keymap, if it was built
+        // from configPath and is up to date; false otherwise
+        bool loadCompiledKeys(const std::string& configPath);
+        // What to do on the bus when an IR key is pressed, as macro steps
+        // (see CecMacroEngine::parse)
+        bool addAction(const std::string& key, const std::string& steps);
+
+        // The IR key a CEC key code is mapped to, KEY_INVALID if none
+        KeyName keyFor(CEC::cec_user_control_code code) const { return mCecKeys[code & 0xFF]; }
+
+        // What an IR key does on the bus, nullptr if nothing
+        const CecMacro* action(const KeyName& key) const;
+
+    private:
+        friend class CecForwarder;
+
+        // What an IR key turns into. A lone step that doesn't wait is sent
+        // straight from the IR thread, a key pressed for as long as the IR
+        // key is held; anything else runs as a macro.
+        struct IRAction {
+            CecMacro macro;
+            bool direct;
+        };
+
+        KeyTable::RemotePtr mKeys;
+        // Indexed by cec_user_control_code
+        std::array<KeyName, 256> mCecKeys;
+        // Indexed by KeyName::Value
+        std::array<IRAction, KeyName::KEY_COUNT> mIRActions;
+    };
+
+    typedef std::shared_ptr<const Bindings> BindingsPtr;
+
+public:
+    // Takes ownership of adapter; a libCEC adapter is used if none is
+    // given
+    CecForwarder(const BindingsPtr& bindings, const std::string& cecname, CecAdapter* adapter = nullptr);
     ~CecForwarder();
 
     void close();
     bool ensureOpen();
 
-    void addKey(int keycode, const std::string& name);
+    // Switch to other bindings, and the IR keys they send, from any
+    // thread. Keys already queued or held and macros already running
+    // carry on with the ones they started with.
+    void setBindings(const BindingsPtr& bindings);
+    BindingsPtr bindings() const;
+
     void setRepeat(int delay, int rate);
+    void setTransmitQueue(size_t capacity, IRTransmitter::Policy policy);
+    IRTransmitter::Stats transmitStats();
+
+    // Write IR to a file rather than the transmitter, see LircPP
+    bool setTransmitFile(const std::string& path);
+    bool waitTransmitIdle(int timeoutMs);
 
-    void onReceive(const KeyName& key) override;
+    // The IR key a CEC key code is mapped to, KEY_INVALID if none
+    KeyName keyFor(CEC::cec_user_control_code code) const { return bindings()->keyFor(code); }
+
+    // Run the key repeat timer and macros on loop
+    void attach(EventLoop& loop);
+
+    void onReceive(const KeyName& key, LircPP::Event event) override;
+
+    // Signalled from the libCEC thread when the adapter connection drops
+    EventNotifier& connectionLost() { return mConnectionLost; }
 
 private:
-    void cecKeyPress(const CEC::cec_keypress* key);
-    void cecCommand(const CEC::cec_command* command);
+    // received is when libCEC handed over the frame, see Latency::now()
+    void cecKeyPress(const CEC::cec_keypress* key, uint64_t received);
+    void cecCommand(const CEC::cec_command* command, uint64_t received);
     void cecAlert(const CEC::libcec_alert type, const CEC::libcec_parameter param);
     void cecLogMessage(const CEC::cec_log_message* message);
 
@@ -37,17 +113,20 @@ private:
     static void HandleCecAlert(void *cbParam, const CEC::libcec_alert type, const CEC::libcec_parameter param);
     static void HandleCecLogMessage(void *cbParam, const CEC::cec_log_message* message);
 
-    bool mVerbose;
-    int mRepeatDelay, mRepeatRate;
-    std::unordered_map<int, std::string> mKeys;
-
-    KeyRepeat mKeyRepeat;
+    // Loaded once per key press, never locked
+    BindingsPtr mBindings;
+    CecMacroEngine mMacroEngine;
 
     CEC::ICECCallbacks mCecCallbacks;
     CEC::libcec_configuration mCecConfig;
 
     std::atomic<bool> mAdapterOpen;
-    CEC::ICECAdapter *mAdapter;
+    EventNotifier mConnectionLost;
+    std::unique_ptr<CecAdapter> mAdapter;
 
     LircPP mLirc;
+    IRTransmitter mTransmitter;
+    KeyRepeater mRepeater;
 };
+
+#endif // CECFORWARDER_CECFORWARDER_H
@@ -0,0 +1,292 @@
+#include <cstdlib>
+#include <sstream>
+
+#include "cecmacro.h"
+#include "log.h"
+
+using namespace CEC;
+
+static const unsigned int DEFAULT_TIMEOUT_MS = 10000;
+
+static bool parseNumber(const std::string& str, unsigned long max, unsigned long& value)
+{
+    char* end = nullptr;
+    value = strtoul(str.c_str(), &end, 0);
+    return !str.empty() && *end == '\0' && value <= max;
+}
+
+static bool parseAddress(const std::string& str, cec_logical_address& address)
+{
+    unsigned long value;
+    if (!parseNumber(str, CECDEVICE_BROADCAST, value)) {
+        return false;
+    }
+
+    address = static_cast<cec_logical_address>(value);
+    return true;
+}
+
+CecMacroEngine::CecMacroEngine()
+    : mAdapter(nullptr)
+    , mStep(0)
+    , mWaiting(false)
+    , mTimedOut(false)
+    , mWaitFor(CECDEVICE_UNKNOWN)
+    , mWaitPhysical(0xFFFF)
+    , mActiveSource(CECDEVICE_UNKNOWN)
+{
+}
+
+void CecMacroEngine::setAdapter(CecAdapter* adapter)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mAdapter = adapter;
+}
+
+bool CecMacroEngine::parse(const std::string& text, CecMacro& macro)
+{
+    macro.clear();
+
+    std::istringstream steps(text);
+    std::string step;
+    while (std::getline(steps, step, ';')) {
+        std::istringstream iss(step);
+        std::vector<std::string> args;
+        std::string arg;
+        while (iss >> arg) {
+            args.push_back(arg);
+        }
+
+        if (args.empty()) {
+            continue;
+        }
+
+        CecMacroStep s = {CecMacroStep::STEP_DELAY, CECDEVICE_UNKNOWN, CECDEVICE_UNKNOWN, CEC_USER_CONTROL_CODE_UNKNOWN, DEFAULT_TIMEOUT_MS};
+        unsigned long value;
+        bool ok = false;
+        if (args[0] == "poweron") {
+            s.type = CecMacroStep::STEP_POWER_ON;
+            ok = (args.size() == 2 || (args.size() == 4 && args[2] == "unless" && parseAddress(args[3], s.unless))) &&
+                parseAddress(args[1], s.address);
+        } else if (args[0] == "standby" && args.size() == 2) {
+            s.type = CecMacroStep::STEP_STANDBY;
+            ok = parseAddress(args[1], s.address);
+        } else if (args[0] == "activesource" && args.size() == 1) {
+            s.type = CecMacroStep::STEP_ACTIVE_SOURCE;
+            ok = true;
+        } else if (args[0] == "volume" && args.size() == 2) {
+            s.type = CecMacroStep::STEP_KEY;
+            s.address = CECDEVICE_AUDIOSYSTEM;
+            ok = true;
+            if (args[1] == "up") {
+                s.key = CEC_USER_CONTROL_CODE_VOLUME_UP;
+            } else if (args[1] == "down") {
+                s.key = CEC_USER_CONTROL_CODE_VOLUME_DOWN;
+            } else if (args[1] == "mute") {
+                s.key = CEC_USER_CONTROL_CODE_MUTE;
+            } else {
+                ok = false;
+            }
+        } else if (args[0] == "key" && args.size() == 3) {
+            s.type = CecMacroStep::STEP_KEY;
+            ok = parseAddress(args[1], s.address) && parseNumber(args[2], CEC_USER_CONTROL_CODE_MAX, value);
+            s.key = static_cast<cec_user_control_code>(value);
+        } else if (args[0] == "waitsource" && (args.size() == 2 || args.size() == 3)) {
+            s.type = CecMacroStep::STEP_WAIT_SOURCE;
+            ok = parseAddress(args[1], s.address) && (args.size() == 2 || parseNumber(args[2], ~0U, value));
+            if (args.size() == 3) {
+                s.timeoutMs = value;
+            }
+        } else if (args[0] == "delay" && args.size() == 2) {
+            ok = parseNumber(args[1], ~0U, value);
+            s.timeoutMs = value;
+        }
+
+        if (!ok) {
+            LOG(WARNING, "Invalid macro step '%s'", step.c_str());
+            return false;
+        }
+
+        macro.push_back(s);
+    }
+
+    return !macro.empty();
+}
+
+void CecMacroEngine::send(const CecMacroStep& step, bool release)
+{
+    CecAdapter* adapter;
+    cec_logical_address active;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        adapter = mAdapter;
+        active = mActiveSource;
+    }
+
+    if (adapter == nullptr) {
+        return;
+    }
+
+    switch (step.type) {
+    case CecMacroStep::STEP_POWER_ON:
+        if (step.unless == CECDEVICE_UNKNOWN || active != step.unless) {
+            adapter->powerOnDevices(step.address);
+        }
+
+        break;
+    case CecMacroStep::STEP_STANDBY:
+        adapter->standbyDevices(step.address);
+        break;
+    case CecMacroStep::STEP_ACTIVE_SOURCE:
+        adapter->setActiveSource();
+        break;
+    case CecMacroStep::STEP_KEY:
+        // Queued without waiting for the acknowledgement, so presses go
+        // out back to back
+        if (release) {
+            adapter->sendKeyRelease(step.address, false);
+        } else {
+            adapter->sendKeypress(step.address, step.key, false);
+        }
+
+        break;
+    default:
+        break;
+    }
+}
+
+void CecMacroEngine::start(const CecMacroPtr& macro)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPending = macro;
+    mWake.notify();
+}
+
+void CecMacroEngine::onCommand(const cec_command& command)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    switch (command.opcode) {
+    case CEC_OPCODE_ACTIVE_SOURCE:
+        mActiveSource = command.initiator;
+        break;
+    case CEC_OPCODE_ROUTING_CHANGE:
+        // The TV switched to the input with the new physical address; only
+        // known to be a device while waiting for it
+        if (command.parameters.size >= 4 && mWaitFor != CECDEVICE_UNKNOWN &&
+                ((command.parameters.data[2] << 8) | command.parameters.data[3]) == mWaitPhysical) {
+            mActiveSource = mWaitFor;
+        }
+
+        break;
+    default:
+        return;
+    }
+
+    if (mWaitFor != CECDEVICE_UNKNOWN && mActiveSource == mWaitFor) {
+        mWake.notify();
+    }
+}
+
+void CecMacroEngine::setActiveSource(cec_logical_address address)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mActiveSource = address;
+}
+
+void CecMacroEngine::attach(EventLoop& loop)
+{
+    loop.add(mWake.fd(), [this] {
+        mWake.clear();
+        advance();
+    });
+
+    // A restart handled earlier in the same batch re-arms the timer,
+    // which leaves nothing to read for the step it was armed for
+    loop.add(mTimer.fd(), [this] {
+        if (mTimer.read() > 0) {
+            expired();
+        }
+    });
+}
+
+void CecMacroEngine::expired()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTimedOut = true;
+    }
+
+    advance();
+}
+
+void CecMacroEngine::advance()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    if (mPending != nullptr) {
+        mMacro = std::move(mPending);
+        mStep = 0;
+        mWaiting = false;
+        mWaitFor = CECDEVICE_UNKNOWN;
+        mTimer.disarm();
+    }
+
+    while (mMacro != nullptr && mStep < mMacro->size() && mPending == nullptr) {
+        const CecMacroStep step = (*mMacro)[mStep];
+        CecAdapter* adapter = mAdapter;
+
+        if (mWaiting) {
+            bool reached = step.type == CecMacroStep::STEP_WAIT_SOURCE && mActiveSource == step.address;
+            if (!reached && !mTimedOut) {
+                return;
+            }
+
+            if (!reached && step.type == CecMacroStep::STEP_WAIT_SOURCE) {
+                LOG(INFO, "Macro: timed out waiting for %d", step.address);
+            }
+
+            mTimer.disarm();
+            mWaiting = false;
+            mWaitFor = CECDEVICE_UNKNOWN;
+            mStep++;
+            continue;
+        }
+
+        if (step.type == CecMacroStep::STEP_WAIT_SOURCE || step.type == CecMacroStep::STEP_DELAY) {
+            if (step.type == CecMacroStep::STEP_WAIT_SOURCE) {
+                if (mActiveSource == step.address) {
+                    mStep++;
+                    continue;
+                }
+
+                mWaitFor = step.address;
+                lock.unlock();
+                uint16_t physical = (adapter != nullptr) ? adapter->getDevicePhysicalAddress(step.address) : 0xFFFF;
+                lock.lock();
+                mWaitPhysical = physical;
+            }
+
+            mWaiting = true;
+            mTimedOut = false;
+            mTimer.arm(step.timeoutMs);
+            continue;
+        }
+
+        // Nothing is held while talking to the adapter, so commands it
+        // triggers can come straight back in
+        mStep++;
+        lock.unlock();
+
+        send(step);
+        if (step.type == CecMacroStep::STEP_KEY) {
+            send(step, true);
+        }
+
+        lock.lock();
+    }
+
+    if (mMacro != nullptr && mStep >= mMacro->size()) {
+        mMacro.reset();
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef CECFORWARDER_CECMACRO_H
+#define CECFORWARDER_CECMACRO_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <libcec/cec.h>
+
+#include "cecadapter.h"
+#include "eventloop.h"
+
+struct CecMacroStep {
+    enum Type {
+        // Power on address, unless a given device already is the active source
+        STEP_POWER_ON,
+        STEP_STANDBY,
+        // Announce ourselves as the active source
+        STEP_ACTIVE_SOURCE,
+        // Press and release a key on address
+        STEP_KEY,
+        // Wait for address to become the active source, or the timeout
+        STEP_WAIT_SOURCE,
+        STEP_DELAY,
+    };
+
+    Type type;
+    CEC::cec_logical_address address;
+    CEC::cec_logical_address unless;
+    CEC::cec_user_control_code key;
+    unsigned int timeoutMs;
+};
+
+typedef std::vector<CecMacroStep> CecMacro;
+typedef std::shared_ptr<const CecMacro> CecMacroPtr;
+
+// Runs a sequence of CEC steps without blocking anyone. Steps are issued
+// from the event loop, and a step that waits for the active source to
+// change is advanced by the Active Source and Routing Change commands the
+// bus delivers rather than by querying the adapter. Starting a macro
+// abandons the one in progress.
+class CecMacroEngine {
+public:
+    CecMacroEngine();
+
+    void setAdapter(CecAdapter* adapter);
+
+    // Steps are separated by ';':
+    //   poweron <address> [unless <address>]
+    //   standby <address>
+    //   activesource
+    //   key <address> <user control code>
+    //   volume up|down|mute    (keys sent to the audio system)
+    //   waitsource <address> [timeout ms]
+    //   delay <ms>
+    static bool parse(const std::string& text, CecMacro& macro);
+
+    // Issue a step that doesn't wait straight away, from any thread. A key
+    // is only pressed, or only released.
+    void send(const CecMacroStep& step, bool release = false);
+
+    // Run macro, which is held on to until it is done; safe from any
+    // thread
+    void start(const CecMacroPtr& macro);
+
+    // Every command seen on the bus, from the libCEC thread
+    void onCommand(const CEC::cec_command& command);
+
+    // Active source as known when the adapter was opened
+    void setActiveSource(CEC::cec_logical_address address);
+
+    void attach(EventLoop& loop);
+
+private:
+    void advance();
+    void expired();
+
+    CecAdapter* mAdapter;
+
+    EventNotifier mWake;
+    EventTimer mTimer;
+
+    std::mutex mMutex;
+    CecMacroPtr mPending;
+    CecMacroPtr mMacro;
+    size_t mStep;
+
+    // The step in progress waits for the timer, or for mWaitFor to become
+    // the active source
+    bool mWaiting;
+    bool mTimedOut;
+    CEC::cec_logical_address mWaitFor;
+    uint16_t mWaitPhysical;
+
+    CEC::cec_logical_address mActiveSource;
+};
+
+#endif // CECFORWARDER_CECMACRO_H
@@ -0,0 +1,80 @@
+#include <cstdint>
+
+#include "codeindex.h"
+
+CodeIndex::CodeIndex()
+{
+    clear();
+}
+
+void CodeIndex::clear()
+{
+    mSlots.assign(16, Slot {nullptr, 0, KeyName()});
+    mBits = 4;
+    mMask = mSlots.size() - 1;
+    mCount = 0;
+}
+
+uint32_t CodeIndex::hash(const IRProtocol* protocol, uint32_t value) const
+{
+    // Fibonacci hashing spreads codes that only differ in a few bits. The
+    // top bits of the product depend on every bit of the code, the low
+    // ones only on the code's low bits.
+    uint32_t h = value ^ static_cast<uint32_t>(reinterpret_cast<uintptr_t>(protocol) >> 4);
+    return (h * 0x9E3779B1U) >> (32 - mBits);
+}
+
+bool CodeIndex::insert(const IRCode& code, const KeyName& key, KeyName* existing)
+{
+    if ((mCount + 1) * 2 > mSlots.size()) {
+        rehash(mSlots.size() * 2);
+    }
+
+    uint32_t i = hash(code.protocol, code.value);
+    while (mSlots[i].protocol != nullptr) {
+        if (mSlots[i].protocol == code.protocol && mSlots[i].value == code.value) {
+            if (existing != nullptr) {
+                *existing = mSlots[i].key;
+            }
+
+            return false;
+        }
+
+        i = (i + 1) & mMask;
+    }
+
+    mSlots[i] = Slot {code.protocol, code.value, key};
+    mCount++;
+    return true;
+}
+
+KeyName CodeIndex::find(const IRCode& code) const
+{
+    uint32_t i = hash(code.protocol, code.value);
+    while (mSlots[i].protocol != nullptr) {
+        if (mSlots[i].value == code.value && mSlots[i].protocol == code.protocol) {
+            return mSlots[i].key;
+        }
+
+        i = (i + 1) & mMask;
+    }
+
+    return KeyName();
+}
+
+void CodeIndex::rehash(size_t capacity)
+{
+    std::vector<Slot> slots(capacity, Slot {nullptr, 0, KeyName()});
+    slots.swap(mSlots);
+    for (mBits = 0; (1U << mBits) < capacity; mBits++) {
+    }
+
+    mMask = capacity - 1;
+    mCount = 0;
+
+    for (auto& slot: slots) {
+        if (slot.protocol != nullptr) {
+            insert(IRCode {slot.protocol, slot.value, false}, slot.key);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef CECFORWARDER_CODEINDEX_H
+#define CECFORWARDER_CODEINDEX_H
+
+#include <vector>
+
+#include "irprotocol.h"
+#include "keyname.h"
+
+// Reverse lookup from a received code to its key. Open addressing with
+// linear probing over a flat array kept at most half full, so a lookup is
+// a hash and, typically, a single slot compare.
+class CodeIndex {
+public:
+    CodeIndex();
+
+    void clear();
+
+    // Returns false, leaving the index untouched, if the code already
+    // maps to a key; that key is stored in existing
+    bool insert(const IRCode& code, const KeyName& key, KeyName* existing = nullptr);
+
+    KeyName find(const IRCode& code) const;
+
+    size_t size() const { return mCount; }
+
+private:
+    struct Slot {
+        const IRProtocol* protocol;
+        uint32_t value;
+        KeyName key;
+    };
+
+    // The home slot of a code
+    uint32_t hash(const IRProtocol* protocol, uint32_t value) const;
+    void rehash(size_t capacity);
+
+    std::vector<Slot> mSlots;
+    // mSlots has 1 << mBits entries
+    uint32_t mBits;
+    uint32_t mMask;
+    size_t mCount;
+};
+
+#endif // CECFORWARDER_CODEINDEX_H
@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "configfile.h"
+
+const ConfigFile::Entry* ConfigFile::Section::find(const char* key) const
+{
+    uint32_t slot;
+    return mFile->findEntry(*this, key, hash(mIndex, key), slot);
+}
+
+const char* ConfigFile::Section::value(const char* key, const char* def) const
+{
+    const Entry* e = find(key);
+    return (e != nullptr) ? e->value : def;
+}
+
+int ConfigFile::Section::intValue(const char* key, int def) const
+{
+    const Entry* e = find(key);
+    return (e != nullptr) ? e->intValue : def;
+}
+
+bool ConfigFile::Section::boolValue(const char* key, bool def) const
+{
+    const Entry* e = find(key);
+    return (e != nullptr) ? e->boolValue : def;
+}
+
+ConfigFile::ConfigFile(const std::string& path)
+    : mPath(path)
+{
+}
+
+bool ConfigFile::parse()
+{
+    mBuffer.clear();
+    mEntries.clear();
+    mSections.clear();
+
+    int fd = open(mPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    // One spare byte terminates the last line
+    mBuffer.resize(st.st_size + 1);
+    size_t size = 0;
+    while (size < static_cast<size_t>(st.st_size)) {
+        ssize_t ret = read(fd, mBuffer.data() + size, st.st_size - size);
+        if (ret <= 0) {
+            break;
+        }
+
+        size += ret;
+    }
+
+    close(fd);
+    mBuffer.resize(size + 1);
+    mBuffer[size] = '\0';
+
+    if (!tokenise() || mSections.empty()) {
+        mEntries.clear();
+        mSections.clear();
+        mSectionSlots.clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool ConfigFile::tokenise()
+{
+    char* buf = mBuffer.data();
+    size_t size = mBuffer.size() - 1;
+
+    // Every line is at most one entry, so entries are never moved and
+    // keys never rehashed while tokenising
+    size_t lines = std::count(buf, buf + size, '\n') + 1;
+    mEntries.reserve(lines);
+    reserve(mKeySlots, lines);
+    reserve(mSectionSlots, 0);
+
+    for (size_t pos = 0; pos < size;) {
+        char* line = buf + pos;
+        char* eol = static_cast<char*>(memchr(line, '\n', size - pos));
+        size_t len = (eol != nullptr) ? eol - line : size - pos;
+        pos += len + 1;
+
+        if (len == 0) {
+            continue;
+        }
+
+        line[len] = '\0';
+        if (line[0] == '[') {
+            char* close = static_cast<char*>(memchr(line, ']', len));
+            if (close == nullptr || close == line + 1) {
+                return false;
+            }
+
+            *close = '\0';
+            addSection(line + 1);
+            continue;
+        }
+
+        // Anything before the first section is ignored
+        if (mSections.empty() || line[0] == '#') {
+            continue;
+        }
+
+        char* eq = static_cast<char*>(memchr(line, '=', len));
+        if (eq == nullptr || eq == line) {
+            return false;
+        }
+
+        *eq = '\0';
+        addEntry(line, eq + 1);
+    }
+
+    for (auto& section: mSections) {
+        section.mEntries = mEntries.data() + section.mFirst;
+    }
+
+    return true;
+}
+
+void ConfigFile::addSection(char* name)
+{
+    Section section;
+    section.mFile = this;
+    section.mIndex = mSections.size();
+    section.mName = name;
+    section.mEntries = nullptr;
+    section.mFirst = mEntries.size();
+    section.mCount = 0;
+    mSections.push_back(section);
+
+    if (mSections.size() * 2 > mSectionSlots.size()) {
+        reserve(mSectionSlots, mSections.size());
+        for (uint32_t i = 0; i < mSections.size(); i++) {
+            indexSection(i);
+        }
+    } else {
+        indexSection(section.mIndex);
+    }
+}
+
+void ConfigFile::indexSection(uint32_t index)
+{
+    // Later sections of the same name are kept, but never found
+    const char* name = mSections[index].mName;
+    uint32_t mask = mSectionSlots.size() - 1;
+    uint32_t h = hash(name);
+    uint32_t i = h & mask;
+    for (; mSectionSlots[i].index != 0; i = (i + 1) & mask) {
+        if (mSectionSlots[i].hash == h && strcmp(mSections[mSectionSlots[i].index - 1].mName, name) == 0) {
+            return;
+        }
+    }
+
+    mSectionSlots[i] = Slot {h, index + 1};
+}
+
+bool ConfigFile::addEntry(char* key, char* value)
+{
+    Section& section = mSections.back();
+    uint32_t h = hash(section.mIndex, key);
+    uint32_t slot;
+    if (findEntry(section, key, h, slot) != nullptr) {
+        return false;
+    }
+
+    mKeySlots[slot] = Slot {h, static_cast<uint32_t>(mEntries.size() + 1)};
+    mEntries.push_back(Entry {key, value, static_cast<int>(strtoul(value, nullptr, 0)), strcmp(value, "true") == 0});
+    section.mCount++;
+    return true;
+}
+
+const ConfigFile::Entry* ConfigFile::findEntry(const Section& section, const char* key, uint32_t h, uint32_t& slot) const
+{
+    uint32_t mask = mKeySlots.size() - 1;
+    for (slot = h & mask; mKeySlots[slot].index != 0; slot = (slot + 1) & mask) {
+        // Entries of a section are contiguous, so the range tells whose a
+        // slot is
+        size_t entry = mKeySlots[slot].index - 1;
+        if (mKeySlots[slot].hash == h && entry - section.mFirst < section.mCount && strcmp(mEntries[entry].key, key) == 0) {
+            return &mEntries[entry];
+        }
+    }
+
+    return nullptr;
+}
+
+void ConfigFile::reserve(std::vector<Slot>& slots, size_t count)
+{
+    size_t capacity = 16;
+    while (capacity < count * 2) {
+        capacity *= 2;
+    }
+
+    slots.assign(capacity, Slot {0, 0});
+}
+
+uint32_t ConfigFile::hash(const char* str)
+{
+    // FNV-1a
+    uint32_t h = 2166136261U;
+    for (; *str != '\0'; str++) {
+        h = (h ^ static_cast<unsigned char>(*str)) * 16777619U;
+    }
+
+    return h;
+}
+
+uint32_t ConfigFile::hash(uint32_t section, const char* key)
+{
+    return hash(key) ^ (section * 0x9E3779B1U);
+}
+
+const ConfigFile::Section* ConfigFile::getSection(const char* name) const
+{
+    if (mSectionSlots.empty()) {
+        return nullptr;
+    }
+
+    uint32_t mask = mSectionSlots.size() - 1;
+    uint32_t h = hash(name);
+    for (uint32_t i = h & mask; mSectionSlots[i].index != 0; i = (i + 1) & mask) {
+        const Section& section = mSections[mSectionSlots[i].index - 1];
+        if (mSectionSlots[i].hash == h && strcmp(section.mName, name) == 0) {
+            return &section;
+        }
+    }
+
+    return nullptr;
+}
+
+bool ConfigFile::contains(const char* section, const char* key) const
+{
+    const Section* s = getSection(section);
+    return s != nullptr && s->hasKey(key);
+}
@@ -0,0 +1,96 @@
+#ifndef CECFORWARDER_CONFIGFILE_H
+#define CECFORWARDER_CONFIGFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only counterpart of HueConfig that accepts the same files. The file
+// is read with a single read() and tokenised in place: separators are
+// overwritten with NULs, so every section name, key and value is a C
+// string pointing into the one buffer. Sections and keys are found through
+// hash tables, and numeric and boolean values are converted once while
+// parsing.
+//
+// As with HueConfig, the first of duplicate keys or sections wins, and a
+// line in a section that is neither a comment nor key=value fails the
+// whole file. Unlike HueConfig, keys iterate in the order of the file.
+class ConfigFile {
+public:
+    struct Entry {
+        const char* key;
+        const char* value;
+        int intValue;
+        bool boolValue;
+    };
+
+    class Section {
+    public:
+        const char* name() const { return mName; }
+
+        const Entry* begin() const { return mEntries; }
+        const Entry* end() const { return mEntries + mCount; }
+
+        // nullptr if there is no such key
+        const Entry* find(const char* key) const;
+
+        bool hasKey(const char* key) const { return find(key) != nullptr; }
+        const char* value(const char* key, const char* def = "") const;
+        int intValue(const char* key, int def = 0) const;
+        bool boolValue(const char* key, bool def = false) const;
+
+    private:
+        friend class ConfigFile;
+
+        const ConfigFile* mFile;
+        uint32_t mIndex;
+        const char* mName;
+        const Entry* mEntries;
+        size_t mFirst, mCount;
+    };
+
+public:
+    ConfigFile(const std::string& path);
+
+    bool parse();
+
+    // The first section called name, nullptr if there is none
+    const Section* getSection(const char* name) const;
+    bool contains(const char* section, const char* key) const;
+
+    const std::string& path() const { return mPath; }
+
+private:
+    ConfigFile(const ConfigFile&);
+    ConfigFile& operator=(const ConfigFile&);
+
+    // Open addressing with linear probing, kept at most half full. index
+    // is that of a section or entry plus one, zero for an empty slot.
+    struct Slot {
+        uint32_t hash;
+        uint32_t index;
+    };
+
+    static uint32_t hash(const char* str);
+    static uint32_t hash(uint32_t section, const char* key);
+    static void reserve(std::vector<Slot>& slots, size_t count);
+
+    bool tokenise();
+    void addSection(char* name);
+    void indexSection(uint32_t index);
+    // False if the current section already has the key
+    bool addEntry(char* key, char* value);
+    // The entry of section with key, whose hash is h; otherwise nullptr,
+    // with the empty slot the key would go in
+    const Entry* findEntry(const Section& section, const char* key, uint32_t h, uint32_t& slot) const;
+
+    std::string mPath;
+    std::vector<char> mBuffer;
+    std::vector<Entry> mEntries;
+    std::vector<Section> mSections;
+    std::vector<Slot> mSectionSlots;
+    std::vector<Slot> mKeySlots;
+};
+
+#endif // CECFORWARDER_CONFIGFILE_H
@@ -0,0 +1,50 @@
+#include "configreloader.h"
+#include "log.h"
+
+// How long files have to be left alone before they are reloaded
+static const unsigned int SETTLE_MS = 500;
+
+ConfigReloader::ConfigReloader(const Reload& reload)
+    : mReload(reload)
+    , mRunning(true)
+{
+}
+
+void ConfigReloader::attach(EventLoop& loop)
+{
+    // Every change pushes the reload back
+    loop.add(mWatcher.fd(), [this] {
+        if (mWatcher.read() > 0) {
+            mSettleTimer.arm(SETTLE_MS);
+        }
+    });
+
+    loop.add(mSettleTimer.fd(), [this] {
+        mSettleTimer.read();
+        mPending.notify();
+    });
+}
+
+void ConfigReloader::cancel()
+{
+    mRunning = false;
+    mPending.notify();
+}
+
+void* ConfigReloader::Process(void)
+{
+    while (mRunning) {
+        // Woken by the settle timer, or by cancel()
+        if (!mPending.wait(-1)) {
+            continue;
+        }
+
+        mPending.clear();
+        if (mRunning) {
+            LOG(NOTICE, "Config changed, reloading");
+            mReload();
+        }
+    }
+
+    return nullptr;
+}
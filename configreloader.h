@@ -0,0 +1,42 @@
+#ifndef CECFORWARDER_CONFIGRELOADER_H
+#define CECFORWARDER_CONFIGRELOADER_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+
+#include <p8-platform/threads/threads.h>
+
+#include "eventloop.h"
+
+// Reloads the config when its files change. Changes are picked up on the
+// loop and left to settle, as saving a file is often several writes and
+// renames; the reload then runs on this thread, so that neither the loop
+// nor key presses ever wait for it.
+class ConfigReloader : public P8PLATFORM::CThread
+{
+public:
+    typedef std::function<void()> Reload;
+
+public:
+    ConfigReloader(const Reload& reload);
+    virtual ~ConfigReloader(void) {}
+
+    // Reload on changes to files in dir
+    bool watch(const std::string& dir) { return mWatcher.watch(dir); }
+    void attach(EventLoop& loop);
+
+    void cancel();
+
+    void* Process(void) override;
+
+private:
+    Reload mReload;
+    std::atomic<bool> mRunning;
+
+    FileWatcher mWatcher;
+    EventTimer mSettleTimer;
+    EventNotifier mPending;
+};
+
+#endif // CECFORWARDER_CONFIGRELOADER_H
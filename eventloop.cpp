@@ -0,0 +1,226 @@
+#include <cerrno>
+#include <cstring>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+
+#include "eventloop.h"
+#include "log.h"
+
+EventLoop::EventLoop()
+    : mEpollFd(epoll_create1(EPOLL_CLOEXEC))
+    , mRunning(false)
+    , mWakeups(0)
+{
+    if (mEpollFd == -1) {
+        LOG(ERROR, "Failed creating epoll instance: %s", strerror(errno));
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    if (mEpollFd != -1) {
+        close(mEpollFd);
+    }
+}
+
+bool EventLoop::add(int fd, const Handler& handler)
+{
+    if (mEpollFd == -1 || fd == -1) {
+        return false;
+    }
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        LOG(ERROR, "Failed adding fd %d to event loop: %s", fd, strerror(errno));
+        return false;
+    }
+
+    mHandlers[fd] = handler;
+    return true;
+}
+
+void EventLoop::remove(int fd)
+{
+    if (mHandlers.erase(fd) > 0) {
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+}
+
+void EventLoop::run()
+{
+    if (mEpollFd == -1) {
+        return;
+    }
+
+    mRunning = true;
+    epoll_event events[8];
+    while (mRunning) {
+        int count = epoll_wait(mEpollFd, events, 8, -1);
+        mWakeups++;
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            LOG(ERROR, "Event loop failed: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < count && mRunning; i++) {
+            // A handler may have removed a later descriptor
+            auto it = mHandlers.find(events[i].data.fd);
+            if (it != mHandlers.end()) {
+                Handler handler = it->second;
+                handler();
+            }
+        }
+    }
+}
+
+EventTimer::EventTimer()
+    : mFd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+{
+    if (mFd == -1) {
+        LOG(ERROR, "Failed creating timer: %s", strerror(errno));
+    }
+}
+
+EventTimer::~EventTimer()
+{
+    if (mFd != -1) {
+        close(mFd);
+    }
+}
+
+bool EventTimer::arm(unsigned int delayMs, unsigned int intervalMs)
+{
+    itimerspec spec;
+    // A zero value would disarm the timer instead
+    delayMs = (delayMs > 0) ? delayMs : 1;
+    spec.it_value.tv_sec = delayMs / 1000;
+    spec.it_value.tv_nsec = (delayMs % 1000) * 1000000L;
+    spec.it_interval.tv_sec = intervalMs / 1000;
+    spec.it_interval.tv_nsec = (intervalMs % 1000) * 1000000L;
+
+    return timerfd_settime(mFd, 0, &spec, nullptr) == 0;
+}
+
+void EventTimer::disarm()
+{
+    itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    timerfd_settime(mFd, 0, &spec, nullptr);
+}
+
+uint64_t EventTimer::read()
+{
+    uint64_t expirations = 0;
+    if (::read(mFd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return 0;
+    }
+
+    return expirations;
+}
+
+EventNotifier::EventNotifier()
+    : mFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+    if (mFd == -1) {
+        LOG(ERROR, "Failed creating eventfd: %s", strerror(errno));
+    }
+}
+
+EventNotifier::~EventNotifier()
+{
+    if (mFd != -1) {
+        close(mFd);
+    }
+}
+
+void EventNotifier::notify()
+{
+    uint64_t one = 1;
+    if (write(mFd, &one, sizeof(one)) != sizeof(one)) {
+        // Only fails when the counter would overflow, so a wakeup is
+        // pending anyway
+    }
+}
+
+void EventNotifier::clear()
+{
+    uint64_t count;
+    if (read(mFd, &count, sizeof(count)) != sizeof(count)) {
+        // Nothing pending
+    }
+}
+
+bool EventNotifier::wait(int timeoutMs)
+{
+    pollfd pfd = {mFd, POLLIN, 0};
+    return poll(&pfd, 1, timeoutMs) > 0;
+}
+
+FileWatcher::FileWatcher()
+    : mFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+    if (mFd == -1) {
+        LOG(ERROR, "Failed creating inotify instance: %s", strerror(errno));
+    }
+}
+
+FileWatcher::~FileWatcher()
+{
+    if (mFd != -1) {
+        close(mFd);
+    }
+}
+
+bool FileWatcher::watch(const std::string& dir)
+{
+    // Replacing a file by renaming over it, as editors and the keymap
+    // compiler do, is a move rather than a write
+    if (mFd == -1 || inotify_add_watch(mFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_ONLYDIR) == -1) {
+        LOG(ERROR, "Failed watching %s: %s", dir.c_str(), strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+unsigned int FileWatcher::read()
+{
+    unsigned int changes = 0;
+    alignas(inotify_event) char buf[4096];
+    ssize_t len;
+    while ((len = ::read(mFd, buf, sizeof(buf))) > 0) {
+        for (char* p = buf; p < buf + len; p += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(p)->len) {
+            const inotify_event* event = reinterpret_cast<inotify_event*>(p);
+            if (event->mask & IN_Q_OVERFLOW) {
+                changes++;
+                continue;
+            }
+
+            if (event->len == 0 || (event->mask & IN_ISDIR)) {
+                continue;
+            }
+
+            size_t n = strlen(event->name);
+            const char* name = event->name;
+            if (name[0] == '.' || name[n - 1] == '~' || (n > 4 && (strcmp(name + n - 4, ".tmp") == 0 || strcmp(name + n - 4, ".swp") == 0))) {
+                continue;
+            }
+
+            changes++;
+        }
+    }
+
+    return changes;
+}
@@ -0,0 +1,97 @@
+#ifndef CECFORWARDER_EVENTLOOP_H
+#define CECFORWARDER_EVENTLOOP_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+
+// Blocking epoll loop. Handlers run on the thread that calls run(), which
+// sleeps in the kernel until one of the registered descriptors is ready.
+class EventLoop {
+public:
+    typedef std::function<void()> Handler;
+
+public:
+    EventLoop();
+    ~EventLoop();
+
+    bool add(int fd, const Handler& handler);
+    void remove(int fd);
+
+    // Dispatch events until stop() is called from a handler
+    void run();
+    void stop() { mRunning = false; }
+
+    // Times the loop has woken up since it was created
+    unsigned long wakeups() const { return mWakeups; }
+
+private:
+    int mEpollFd;
+    bool mRunning;
+    std::atomic<unsigned long> mWakeups;
+
+    std::map<int, Handler> mHandlers;
+};
+
+// One-shot or periodic timer on CLOCK_MONOTONIC
+class EventTimer {
+public:
+    EventTimer();
+    ~EventTimer();
+
+    // Fire after delayMs, then every intervalMs if that is non-zero
+    bool arm(unsigned int delayMs, unsigned int intervalMs = 0);
+    void disarm();
+
+    // Acknowledge the timer; returns how many times it expired
+    uint64_t read();
+
+    int fd() const { return mFd; }
+
+private:
+    int mFd;
+};
+
+// Wakes up a loop from any thread
+class EventNotifier {
+public:
+    EventNotifier();
+    ~EventNotifier();
+
+    void notify();
+
+    // Acknowledge all pending notifications
+    void clear();
+
+    // Block until notified, for threads that don't run an EventLoop;
+    // false on timeout. A negative timeout waits forever. Doesn't clear.
+    bool wait(int timeoutMs);
+
+    int fd() const { return mFd; }
+
+private:
+    int mFd;
+};
+
+// Files written, moved in or deleted in watched directories, through
+// inotify. Hidden files and editor backups are left out.
+class FileWatcher {
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    // Not recursive: files in subdirectories need a watch of their own
+    bool watch(const std::string& dir);
+
+    // Acknowledge pending events; returns how many were of interest
+    unsigned int read();
+
+    int fd() const { return mFd; }
+
+private:
+    int mFd;
+};
+
+#endif // CECFORWARDER_EVENTLOOP_H
@@ -0,0 +1,392 @@
+#include <algorithm>
+
+#include "irdecoder.h"
+
+IRDecoder::Window::Window(unsigned int target, unsigned int tolerance)
+    : target(target)
+    , min(target * (100 - tolerance) / 100)
+    , max(target * (100 + tolerance) / 100)
+{
+}
+
+unsigned int IRDecoder::Window::distance(unsigned int value) const
+{
+    unsigned int diff = (value > target) ? value - target : target - value;
+    return (target > 0) ? diff * 1000 / target : 0;
+}
+
+IRDecoder::IRDecoder()
+{
+    init(IRProtocol::sProtocols, IRProtocol::sProtocolCount);
+}
+
+IRDecoder::IRDecoder(const IRProtocol* const* protocols, size_t count)
+{
+    init(protocols, count);
+}
+
+void IRDecoder::init(const IRProtocol* const* protocols, size_t count)
+{
+    mMaxSpace = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const IRProtocol* p = protocols[i];
+
+        Family* family = nullptr;
+        for (auto& f: mFamilies) {
+            const IRProtocol* t = f.timing;
+            if (t->encoding == p->encoding &&
+                    t->headerPulse == p->headerPulse && t->headerSpace == p->headerSpace &&
+                    t->zeroPulse == p->zeroPulse && t->zeroSpace == p->zeroSpace &&
+                    t->onePulse == p->onePulse && t->oneSpace == p->oneSpace &&
+                    t->onePulseFirst == p->onePulseFirst && t->doubleBit == p->doubleBit) {
+                family = &f;
+                break;
+            }
+        }
+
+        if (family == nullptr) {
+            mFamilies.push_back(Family());
+            family = &mFamilies.back();
+            family->timing = p;
+            family->maxBits = 0;
+            family->headerPulse = Window(p->headerPulse, p->tolerance);
+            family->headerSpace = Window(p->headerSpace, p->tolerance);
+            family->repeatSpace = Window(p->repeatSpace, p->tolerance);
+            family->zeroPulse = Window(p->zeroPulse, p->tolerance);
+            family->zeroSpace = Window(p->zeroSpace, p->tolerance);
+            family->onePulse = Window(p->onePulse, p->tolerance);
+            family->oneSpace = Window(p->oneSpace, p->tolerance);
+            for (unsigned int n = 0; n < 3; n++) {
+                family->units[n] = Window(p->zeroPulse * (n + 1), p->tolerance);
+            }
+
+            mMaxSpace = std::max(mMaxSpace, family->headerSpace.max);
+            if (p->encoding == IRProtocol::ENCODING_MANCHESTER) {
+                mMaxSpace = std::max(mMaxSpace, family->units[2].max);
+            } else {
+                mMaxSpace = std::max(mMaxSpace, std::max(family->zeroSpace.max, family->oneSpace.max));
+            }
+        }
+
+        family->protocols.push_back(p);
+        family->maxBits = std::max(family->maxBits, p->bits);
+    }
+
+    reset();
+}
+
+void IRDecoder::reset()
+{
+    mState = STATE_IDLE;
+    mCandidates = 0;
+    mHeaderPulse = 0;
+    mFamily = nullptr;
+    mEncoding = IRProtocol::ENCODING_PULSE_DISTANCE;
+    mBits = 0;
+    mValue = 0;
+    mLevels = 0;
+    mUnits = mUnitPos = 0;
+}
+
+bool IRDecoder::push(bool pulse, unsigned int duration, IRCode& code)
+{
+    // Kept to the bits of a frame; the rest is out of line, so that a bit
+    // costs little more than its compares
+    switch (mState) {
+    case STATE_IDLE:
+        if (pulse) {
+            start(duration);
+        }
+
+        return false;
+    case STATE_HEADER:
+        return header(pulse, duration, code);
+    case STATE_PULSE:
+        if (!pulse) {
+            break;
+        }
+
+        if (mEncoding == IRProtocol::ENCODING_PULSE_DISTANCE) {
+            if (!mFamily->zeroPulse.match(duration)) {
+                break;
+            }
+
+            mState = STATE_SPACE;
+            return false;
+        }
+
+        if (!bit(mFamily->onePulse, mFamily->zeroPulse, duration)) {
+            break;
+        }
+
+        if (mBits == mFamily->maxBits) {
+            return complete(code);
+        }
+
+        mState = STATE_SPACE;
+        return false;
+    case STATE_SPACE:
+        if (pulse) {
+            break;
+        }
+
+        if (mEncoding == IRProtocol::ENCODING_PULSE_WIDTH) {
+            if (mFamily->zeroSpace.match(duration)) {
+                mState = STATE_PULSE;
+                return false;
+            }
+
+            // Anything longer than the separator ends a short variant
+            return complete(code);
+        }
+
+        if (!bit(mFamily->oneSpace, mFamily->zeroSpace, duration)) {
+            break;
+        }
+
+        // Whatever trails the last bit carries no data
+        if (mBits == mFamily->maxBits) {
+            return complete(code);
+        }
+
+        mState = STATE_PULSE;
+        return false;
+    case STATE_MANCHESTER:
+        return manchester(pulse, duration, code);
+    }
+
+    return resync(pulse, duration);
+}
+
+void IRDecoder::start(unsigned int duration)
+{
+    for (uint32_t i = 0; i < mFamilies.size(); i++) {
+        const Family& f = mFamilies[i];
+        bool match = (f.timing->headerPulse > 0) ? f.headerPulse.match(duration) : units(f, duration) > 0;
+        if (match) {
+            mCandidates |= 1U << i;
+        }
+    }
+
+    if (mCandidates != 0) {
+        mState = STATE_HEADER;
+        mHeaderPulse = duration;
+    }
+}
+
+bool IRDecoder::header(bool pulse, unsigned int duration, IRCode& code)
+{
+    if (pulse) {
+        return resync(pulse, duration);
+    }
+
+    if (repeat(duration, code)) {
+        return true;
+    }
+
+    if (!selectFamily(duration)) {
+        return resync(pulse, duration);
+    }
+
+    if (mFamily->timing->headerPulse > 0) {
+        mState = (mEncoding == IRProtocol::ENCODING_MANCHESTER) ? STATE_MANCHESTER : STATE_PULSE;
+        return false;
+    }
+
+    // No header, so what we took for one was the first data pulse,
+    // preceded by the space half of the start bit
+    mState = STATE_MANCHESTER;
+    if (!addUnits(false, 1) || !addUnits(true, units(*mFamily, mHeaderPulse))) {
+        return resync(pulse, duration);
+    }
+
+    return manchester(pulse, duration, code);
+}
+
+bool IRDecoder::resync(bool pulse, unsigned int duration)
+{
+    // Out of sync; this may be the start of the next frame
+    reset();
+    if (pulse) {
+        start(duration);
+    }
+
+    return false;
+}
+
+bool IRDecoder::bit(const Window& one, const Window& zero, unsigned int duration)
+{
+    // Both windows are always checked and the bit shifted in without a
+    // branch, which would mispredict on every other bit of a code
+    uint32_t isOne = one.match(duration);
+    uint32_t isZero = zero.match(duration);
+    mValue = (mValue << 1) | isOne;
+    mBits++;
+    return isOne + isZero != 0;
+}
+
+bool IRDecoder::finish(IRCode& code)
+{
+    if (mState == STATE_SPACE && mEncoding == IRProtocol::ENCODING_PULSE_WIDTH) {
+        return complete(code);
+    }
+
+    reset();
+    return false;
+}
+
+bool IRDecoder::repeat(unsigned int space, IRCode& code)
+{
+    for (uint32_t i = 0; i < mFamilies.size(); i++) {
+        const Family& f = mFamilies[i];
+        if ((mCandidates & (1U << i)) == 0 || f.timing->repeatSpace == 0 || !f.repeatSpace.match(space)) {
+            continue;
+        }
+
+        // The trailing pulse carries nothing, so don't wait for it
+        code.protocol = f.timing;
+        code.value = 0;
+        code.repeat = true;
+        reset();
+        return true;
+    }
+
+    return false;
+}
+
+bool IRDecoder::selectFamily(unsigned int space)
+{
+    // The closest header wins; headerless protocols only if none fits
+    const Family* headerless = nullptr;
+    unsigned int best = ~0U;
+    for (uint32_t i = 0; i < mFamilies.size(); i++) {
+        if ((mCandidates & (1U << i)) == 0) {
+            continue;
+        }
+
+        const Family& f = mFamilies[i];
+        if (f.timing->headerPulse == 0) {
+            if (headerless == nullptr && units(f, space) > 0) {
+                headerless = &f;
+            }
+
+            continue;
+        }
+
+        if (!f.headerSpace.match(space)) {
+            continue;
+        }
+
+        unsigned int distance = f.headerPulse.distance(mHeaderPulse) + f.headerSpace.distance(space);
+        if (distance < best) {
+            best = distance;
+            mFamily = &f;
+        }
+    }
+
+    if (mFamily == nullptr) {
+        mFamily = headerless;
+    }
+
+    if (mFamily == nullptr) {
+        return false;
+    }
+
+    mEncoding = mFamily->timing->encoding;
+    mBits = 0;
+    mValue = 0;
+    return true;
+}
+
+bool IRDecoder::complete(IRCode& code)
+{
+    const Family* family = mFamily;
+    unsigned int bits = mBits;
+    uint32_t value = mValue;
+    reset();
+
+    for (auto* p: family->protocols) {
+        if (p->bits != bits || (value & p->fixedMask) != p->fixedValue) {
+            continue;
+        }
+
+        uint32_t v = value & ~p->toggleMask;
+        if (p->validate != nullptr && !p->validate(v)) {
+            continue;
+        }
+
+        code.protocol = p;
+        code.value = v;
+        code.repeat = false;
+        return true;
+    }
+
+    return false;
+}
+
+unsigned int IRDecoder::units(const Family& family, unsigned int duration) const
+{
+    // Selects rather than branches, as the run lengths follow the data.
+    // Windows may overlap, where the shorter run wins.
+    unsigned int n = family.units[2].match(duration) ? 3 : 0;
+    n = family.units[1].match(duration) ? 2 : n;
+    return family.units[0].match(duration) ? 1 : n;
+}
+
+bool IRDecoder::addUnits(bool pulse, unsigned int count)
+{
+    if (count == 0 || mUnits + count > 64) {
+        return false;
+    }
+
+    uint64_t run = ((1ULL << count) - 1) << mUnits;
+    mLevels |= run & -static_cast<uint64_t>(pulse);
+    mUnits += count;
+    return true;
+}
+
+bool IRDecoder::manchester(bool pulse, unsigned int duration, IRCode& code)
+{
+    if (!addUnits(pulse, units(*mFamily, duration))) {
+        reset();
+        return pulse ? push(pulse, duration, code) : false;
+    }
+
+    const IRProtocol* timing = mFamily->timing;
+    while (mBits < mFamily->maxBits) {
+        unsigned int width = (static_cast<int>(mBits) == timing->doubleBit) ? 2 : 1;
+        if (mUnitPos + width > mUnits) {
+            return false;
+        }
+
+        uint64_t mask = (1ULL << width) - 1;
+        uint64_t first = (mLevels >> mUnitPos) & mask;
+        if (first != 0 && first != mask) {
+            break;
+        }
+
+        if (mUnitPos + width * 2 > mUnits) {
+            // A final bit that starts with a pulse ends in a space that
+            // runs into the gap, so don't wait for it
+            if (mBits + 1 < mFamily->maxBits || first == 0) {
+                return false;
+            }
+        } else if (((mLevels >> (mUnitPos + width)) & mask) != (first ^ mask)) {
+            break;
+        }
+
+        bool one = (first != 0) == timing->onePulseFirst;
+        mValue = (mValue << 1) | (one ? 1U : 0U);
+        mUnitPos += width * 2;
+        mBits++;
+    }
+
+    if (mBits == mFamily->maxBits) {
+        return complete(code);
+    }
+
+    // Manchester violation; a pulse may still start a new frame
+    reset();
+    return pulse ? push(pulse, duration, code) : false;
+}
@@ -0,0 +1,104 @@
+#ifndef CECFORWARDER_IRDECODER_H
+#define CECFORWARDER_IRDECODER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "irprotocol.h"
+
+// Incremental, table-driven IR decoder. Pulses and spaces are pushed one at
+// a time as they come off the receiver. The header picks the protocol, the
+// bits are matched against integer windows precomputed from the protocol
+// table, and a code is returned as soon as the last symbol of a frame has
+// been seen, without waiting for the gap that follows it.
+class IRDecoder {
+public:
+    IRDecoder();
+    IRDecoder(const IRProtocol* const* protocols, size_t count);
+
+    // Returns true once a complete frame has been decoded into code. A
+    // repeat frame is returned with code.repeat set, as soon as its header
+    // has been seen.
+    bool push(bool pulse, unsigned int duration, IRCode& code);
+
+    // The receiver went idle; completes frames whose length is only known
+    // from the gap that ends them
+    bool finish(IRCode& code);
+
+    void reset();
+
+    // Longest space that can occur inside a valid frame, in microseconds
+    unsigned int maxSpace() const { return mMaxSpace; }
+
+private:
+    struct Window {
+        Window(unsigned int target = 0, unsigned int tolerance = 0);
+
+        // Unsigned wrap-around folds both bounds into one compare
+        bool match(unsigned int value) const { return value - min <= max - min; }
+
+        // Relative distance from the target, in permille
+        unsigned int distance(unsigned int value) const;
+
+        unsigned int target, min, max;
+    };
+
+    // Protocols with identical header and bit timing, told apart by length
+    // or validation once all bits are in
+    struct Family {
+        std::vector<const IRProtocol*> protocols;
+        const IRProtocol* timing;
+        unsigned int maxBits;
+
+        Window headerPulse, headerSpace, repeatSpace;
+        Window zeroPulse, zeroSpace, onePulse, oneSpace;
+
+        // Manchester runs of one to three half-bit units
+        Window units[3];
+    };
+
+    enum State {
+        STATE_IDLE,
+        STATE_HEADER,
+        STATE_PULSE,
+        STATE_SPACE,
+        STATE_MANCHESTER,
+    };
+
+    void init(const IRProtocol* const* protocols, size_t count);
+
+    // A pulse that may be a header
+    void start(unsigned int duration);
+    bool header(bool pulse, unsigned int duration, IRCode& code);
+    // Drop the frame; pulse may be the start of the next one
+    bool resync(bool pulse, unsigned int duration);
+
+    // Shift in the bit duration stands for; false if it fits neither
+    bool bit(const Window& one, const Window& zero, unsigned int duration);
+
+    bool selectFamily(unsigned int space);
+    bool repeat(unsigned int space, IRCode& code);
+    bool complete(IRCode& code);
+
+    unsigned int units(const Family& family, unsigned int duration) const;
+    bool addUnits(bool pulse, unsigned int count);
+    bool manchester(bool pulse, unsigned int duration, IRCode& code);
+
+    std::vector<Family> mFamilies;
+    unsigned int mMaxSpace;
+
+    State mState;
+    uint32_t mCandidates;
+    unsigned int mHeaderPulse;
+    const Family* mFamily;
+    IRProtocol::Encoding mEncoding;
+
+    unsigned int mBits;
+    uint32_t mValue;
+
+    // Manchester half-bit levels, unit i in bit i
+    uint64_t mLevels;
+    unsigned int mUnits, mUnitPos;
+};
+
+#endif // CECFORWARDER_IRDECODER_H
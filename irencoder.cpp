@@ -0,0 +1,95 @@
+#include "irencoder.h"
+
+IREncoder::IREncoder(std::vector<unsigned int>& data)
+    : mData(data)
+    , mPulse(false)
+    , mLength(0)
+{
+    mData.clear();
+}
+
+bool IREncoder::encode(const IRCode& code, std::vector<unsigned int>& data)
+{
+    const IRProtocol* p = code.protocol;
+    if (p == nullptr) {
+        return false;
+    }
+
+    IREncoder encoder(data);
+    uint32_t value = p->normalize(code.value);
+    for (unsigned int i = 0; i < p->minFrames; i++) {
+        unsigned int start = encoder.mLength;
+        encoder.frame(p, value);
+
+        // Pad out to the repetition period before the next frame
+        unsigned int length = encoder.mLength - start;
+        if (i + 1 < p->minFrames && p->period > length) {
+            encoder.add(false, p->period - length);
+        }
+    }
+
+    encoder.finish();
+    return !data.empty();
+}
+
+bool IREncoder::encodeRepeat(const IRProtocol* protocol, std::vector<unsigned int>& data)
+{
+    if (protocol == nullptr || protocol->repeatSpace == 0) {
+        return false;
+    }
+
+    IREncoder encoder(data);
+    encoder.add(true, protocol->headerPulse);
+    encoder.add(false, protocol->repeatSpace);
+    encoder.add(true, protocol->trailerPulse);
+    return true;
+}
+
+void IREncoder::add(bool pulse, unsigned int duration)
+{
+    // Transmitters start on a pulse
+    if (duration == 0 || (mData.empty() && !pulse)) {
+        return;
+    }
+
+    mLength += duration;
+    if (!mData.empty() && mPulse == pulse) {
+        mData.back() += duration;
+        return;
+    }
+
+    mData.push_back(duration);
+    mPulse = pulse;
+}
+
+void IREncoder::frame(const IRProtocol* p, uint32_t value)
+{
+    add(true, p->headerPulse);
+    add(false, p->headerSpace);
+
+    for (int i = p->bits - 1, bit = 0; i >= 0; i--, bit++) {
+        bool one = (value >> i) & 1U;
+
+        if (p->encoding == IRProtocol::ENCODING_MANCHESTER) {
+            unsigned int unit = p->zeroPulse * ((bit == p->doubleBit) ? 2 : 1);
+            bool pulseFirst = one == p->onePulseFirst;
+            add(pulseFirst, unit);
+            add(!pulseFirst, unit);
+        } else {
+            add(true, one ? p->onePulse : p->zeroPulse);
+            add(false, one ? p->oneSpace : p->zeroSpace);
+        }
+    }
+
+    add(true, p->trailerPulse);
+}
+
+void IREncoder::finish()
+{
+    // Transmitters end on a pulse; the final space is implied
+    if (!mData.empty() && !mPulse) {
+        mLength -= mData.back();
+        mData.pop_back();
+        mPulse = true;
+    }
+}
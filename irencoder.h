@@ -0,0 +1,40 @@
+#ifndef CECFORWARDER_IRENCODER_H
+#define CECFORWARDER_IRENCODER_H
+
+#include <vector>
+
+#include "irprotocol.h"
+
+// Pulse/space train for one key press, in the form a LIRC transmitter
+// takes it: alternating durations in microseconds, starting and ending
+// with a pulse. The durations live elsewhere, typically in a Keymap.
+struct IRWaveform {
+    const IRProtocol* protocol;
+    unsigned int carrier;
+    const unsigned int* data;
+    size_t size;
+};
+
+// Encoders fill data with the durations of a waveform for the protocol,
+// whose carrier it is sent on
+class IREncoder {
+public:
+    static bool encode(const IRCode& code, std::vector<unsigned int>& data);
+
+    // The short frame a protocol sends while a key is held; false for
+    // protocols that simply resend the whole frame
+    static bool encodeRepeat(const IRProtocol* protocol, std::vector<unsigned int>& data);
+
+private:
+    IREncoder(std::vector<unsigned int>& data);
+
+    void add(bool pulse, unsigned int duration);
+    void frame(const IRProtocol* p, uint32_t value);
+    void finish();
+
+    std::vector<unsigned int>& mData;
+    bool mPulse;
+    unsigned int mLength;
+};
+
+#endif // CECFORWARDER_IRENCODER_H
@@ -0,0 +1,148 @@
+#include <cstdlib>
+
+#include "irprotocol.h"
+
+// Address and command are each followed by their inverse
+static bool validateNEC(uint32_t value)
+{
+    return (((value >> 24) ^ (value >> 16)) & 0xFF) == 0xFF &&
+        (((value >> 8) ^ value) & 0xFF) == 0xFF;
+}
+
+const IRProtocol IRProtocol::NEC = {
+    "nec", ENCODING_PULSE_DISTANCE, 38000, 25,
+    9000, 4500, 2250,
+    563, 563, 563, 1687,
+    32, 563,
+    108000, 1,
+    false, -1,
+    0, 0, 0,
+    validateNEC,
+};
+
+// Extended NEC drops the inverted address byte, so anything with NEC timing
+// that fails the stricter check above lands here
+const IRProtocol IRProtocol::NECX = {
+    "necx", ENCODING_PULSE_DISTANCE, 38000, 25,
+    9000, 4500, 2250,
+    563, 563, 563, 1687,
+    32, 563,
+    108000, 1,
+    false, -1,
+    0, 0, 0,
+    nullptr,
+};
+
+// Start bit, field bit, toggle, 5 address and 6 command bits
+const IRProtocol IRProtocol::RC5 = {
+    "rc5", ENCODING_MANCHESTER, 36000, 25,
+    0, 0, 0,
+    889, 889, 889, 889,
+    14, 0,
+    113778, 1,
+    false, -1,
+    1U << 13, 1U << 13, 1U << 11,
+    nullptr,
+};
+
+// Start bit, mode 0, double width toggle, 8 address and 8 command bits
+const IRProtocol IRProtocol::RC6 = {
+    "rc6", ENCODING_MANCHESTER, 36000, 25,
+    2666, 889, 0,
+    444, 444, 444, 444,
+    21, 0,
+    106667, 1,
+    true, 4,
+    0xFU << 17, 1U << 20, 1U << 16,
+    nullptr,
+};
+
+const IRProtocol IRProtocol::SIRC12 = {
+    "sirc12", ENCODING_PULSE_WIDTH, 40000, 25,
+    2400, 600, 0,
+    600, 600, 1200, 600,
+    12, 0,
+    45000, 3,
+    false, -1,
+    0, 0, 0,
+    nullptr,
+};
+
+const IRProtocol IRProtocol::SIRC15 = {
+    "sirc15", ENCODING_PULSE_WIDTH, 40000, 25,
+    2400, 600, 0,
+    600, 600, 1200, 600,
+    15, 0,
+    45000, 3,
+    false, -1,
+    0, 0, 0,
+    nullptr,
+};
+
+const IRProtocol IRProtocol::SIRC20 = {
+    "sirc20", ENCODING_PULSE_WIDTH, 40000, 25,
+    2400, 600, 0,
+    600, 600, 1200, 600,
+    20, 0,
+    45000, 3,
+    false, -1,
+    0, 0, 0,
+    nullptr,
+};
+
+const IRProtocol IRProtocol::SAMSUNG32 = {
+    "samsung32", ENCODING_PULSE_DISTANCE, 38000, 25,
+    4500, 4500, 0,
+    560, 560, 560, 1690,
+    32, 560,
+    108000, 1,
+    false, -1,
+    0, 0, 0,
+    nullptr,
+};
+
+const IRProtocol* const IRProtocol::sProtocols[] = {
+    &IRProtocol::NEC,
+    &IRProtocol::NECX,
+    &IRProtocol::RC5,
+    &IRProtocol::RC6,
+    &IRProtocol::SIRC12,
+    &IRProtocol::SIRC15,
+    &IRProtocol::SIRC20,
+    &IRProtocol::SAMSUNG32,
+};
+
+const size_t IRProtocol::sProtocolCount = sizeof(IRProtocol::sProtocols) / sizeof(IRProtocol::sProtocols[0]);
+
+bool IRCode::parse(const std::string& str, IRCode& code)
+{
+    code.protocol = &IRProtocol::NEC;
+
+    std::string value = str;
+    size_t pos = str.find(':');
+    if (pos != std::string::npos) {
+        code.protocol = IRProtocol::find(str.substr(0, pos));
+        value = str.substr(pos + 1);
+    }
+
+    if (code.protocol == nullptr || value.empty()) {
+        return false;
+    }
+
+    code.repeat = false;
+
+    char* end = nullptr;
+    code.value = code.protocol->normalize(strtoul(value.c_str(), &end, 0));
+    return *end == '\0';
+}
+
+const IRProtocol* IRProtocol::find(const std::string& name)
+{
+    for (size_t i = 0; i < sProtocolCount; i++) {
+        if (name == sProtocols[i]->name) {
+            return sProtocols[i];
+        }
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,100 @@
+#ifndef CECFORWARDER_IRPROTOCOL_H
+#define CECFORWARDER_IRPROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Timing description of an IR protocol. All durations are in microseconds.
+//
+// Values are kept in the order the bits are sent, first bit in the most
+// significant position, including any start and mode bits. The toggle bit,
+// if the protocol has one, always reads as zero.
+struct IRProtocol {
+    enum Encoding {
+        // Fixed pulse, the space length carries the bit (NEC, Samsung)
+        ENCODING_PULSE_DISTANCE,
+        // Fixed space, the pulse length carries the bit (Sony)
+        ENCODING_PULSE_WIDTH,
+        // Bi-phase, every bit is a pulse and a space of one unit each (RC5, RC6)
+        ENCODING_MANCHESTER,
+    };
+
+    const char* name;
+    Encoding encoding;
+
+    unsigned int carrier;
+    unsigned int tolerance;
+
+    // Leading pulse and space, zero for protocols without a header
+    unsigned int headerPulse;
+    unsigned int headerSpace;
+
+    // Space after the header pulse of a repeat frame, which stands in for
+    // the full frame while a key is held (NEC). Zero if there is none.
+    unsigned int repeatSpace;
+
+    // Pulse-distance and pulse-width bit timings. Manchester protocols use
+    // zeroPulse as the half-bit unit.
+    unsigned int zeroPulse;
+    unsigned int zeroSpace;
+    unsigned int onePulse;
+    unsigned int oneSpace;
+
+    unsigned int bits;
+    unsigned int trailerPulse;
+
+    // Frame repetition period and how many frames make up one key press,
+    // for protocols whose receivers want to see a frame more than once
+    unsigned int period;
+    unsigned int minFrames;
+
+    // Manchester only: a one is sent pulse first rather than space first,
+    // and the index of a bit sent at twice the normal width (-1 for none)
+    bool onePulseFirst;
+    int doubleBit;
+
+    // Bits that must read as fixedValue (start and mode bits), and the
+    // toggle bit
+    uint32_t fixedMask;
+    uint32_t fixedValue;
+    uint32_t toggleMask;
+
+    // Optional extra check of a decoded value
+    bool (*validate)(uint32_t value);
+
+    // Bring a value into the canonical form a decoder produces
+    uint32_t normalize(uint32_t value) const {
+        value &= (bits < 32) ? ((1U << bits) - 1) : ~0U;
+        return (value & ~(fixedMask | toggleMask)) | fixedValue;
+    }
+
+    static const IRProtocol NEC;
+    static const IRProtocol NECX;
+    static const IRProtocol RC5;
+    static const IRProtocol RC6;
+    static const IRProtocol SIRC12;
+    static const IRProtocol SIRC15;
+    static const IRProtocol SIRC20;
+    static const IRProtocol SAMSUNG32;
+
+    // Every known protocol; ones that share a header are listed stricter
+    // first
+    static const IRProtocol* const sProtocols[];
+    static const size_t sProtocolCount;
+
+    static const IRProtocol* find(const std::string& name);
+};
+
+struct IRCode {
+    const IRProtocol* protocol;
+    uint32_t value;
+
+    // A repeat frame; value is meaningless
+    bool repeat;
+
+    // Parse "<protocol>:<value>", or a bare value for NEC
+    static bool parse(const std::string& str, IRCode& code);
+};
+
+#endif // CECFORWARDER_IRPROTOCOL_H
@@ -1,10 +1,17 @@
-#include <iostream>
 #include "irreader.h"
+#include "latency.h"
+#include "log.h"
 
-IRReader::IRReader(const std::string& baseDir, const std::string& keyname, bool recordOnly)
+IRReader::IRReader(const KeyTable::RemotePtr& keys, bool recordOnly)
     : mRunning(true)
     , mRecordOnly(recordOnly)
-    , mLirc(baseDir + "/keys/" + keyname)
+    , mLirc(keys)
+    , mDispatcher(*this)
+    , mDispatching(false)
+    , mMaxDepth(0)
+    , mDispatched(0)
+    , mOverflows(0)
+    , mReleaseOverflows(0)
 {
 }
 
@@ -13,31 +20,122 @@ void IRReader::setVerbose(bool v)
     mLirc.setVerbose(v);
 }
 
+bool IRReader::setCapture(const std::string& path)
+{
+    if (!mCapture.open(path)) {
+        return false;
+    }
+
+    mLirc.receiver().setCapture(&mCapture);
+    return true;
+}
+
 void IRReader::addCallback(Callback* cb) {
     mCallbacks.push_back(cb);
 }
 
+IRReader::Stats IRReader::stats() const
+{
+    Stats stats;
+    stats.depth = mRing.size();
+    stats.maxDepth = mMaxDepth;
+    stats.dispatched = mDispatched;
+    stats.overflows = mOverflows;
+    stats.releaseOverflows = mReleaseOverflows;
+    stats.frameSyscalls = mLirc.frameSyscalls();
+    return stats;
+}
+
 void IRReader::cancel() {
     mRunning = false;
 }
 
+void IRReader::dispatch()
+{
+    while (mDispatching) {
+        // Woken for every key, and once more to stop
+        if (mPending.wait(-1)) {
+            mPending.clear();
+        }
+
+        Received received;
+        while (mRing.pop(received)) {
+            for (auto* cb: mCallbacks) {
+                cb->onReceive(received.key, received.event);
+            }
+
+            mDispatched.fetch_add(1, std::memory_order_relaxed);
+            Latency::record(Latency::STAGE_IR_TO_CEC, received.time);
+        }
+    }
+}
+
 void* IRReader::Process()
 {
+    if (!mRecordOnly) {
+        mDispatching = true;
+        mDispatcher.CreateThread(false);
+    }
+
     KeyName key;
+    LircPP::Event event;
+    // Whether the press of the key being held went into the ring
+    bool pressQueued = false;
     while (mRunning) {
         if (mRecordOnly) {
-            uint32_t value = 0;
-            if (mLirc.receiveRaw(value)) {
-                std::cout << "Received " << std::hex << value << "\n";
+            IRCode code;
+            if (!mLirc.receiveRaw(code)) {
+                continue;
+            }
+
+            if (code.repeat) {
+                LOG(NOTICE, "Received %s repeat", code.protocol->name);
+            } else {
+                LOG(NOTICE, "Received %s:0x%x", code.protocol->name, code.value);
             }
 
             continue;
         }
 
-        if (mLirc.receive(key)) {
-            for (auto* cb: mCallbacks) {
-                cb->onReceive(key);
+        if (!mLirc.receive(key, event)) {
+            continue;
+        }
+
+        // Never wait for the dispatcher; if it has fallen this far behind
+        // the key is dropped. The last slot is kept for releases, so a key
+        // that got in is never left pressed; one that didn't is dropped
+        // whole, its repeats and release included.
+        if (event == LircPP::EVENT_RELEASE) {
+            bool queued = pressQueued && mRing.push(Received {key, event, Latency::now()});
+            pressQueued = false;
+            if (!queued) {
+                mReleaseOverflows.fetch_add(1, std::memory_order_relaxed);
+                continue;
             }
+        } else {
+            if ((event == LircPP::EVENT_REPEAT && !pressQueued) || mRing.size() >= mRing.capacity() - 1 ||
+                    !mRing.push(Received {key, event, Latency::now()})) {
+                mOverflows.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            pressQueued = true;
+        }
+
+        size_t depth = mRing.size();
+        if (depth > mMaxDepth.load(std::memory_order_relaxed)) {
+            mMaxDepth.store(depth, std::memory_order_relaxed);
         }
+
+        mPending.notify();
+    }
+
+    if (mDispatching) {
+        mDispatching = false;
+        mPending.notify();
+        mDispatcher.StopThread();
     }
+
+    mCapture.close();
+    return nullptr;
 }
\ No newline at end of file
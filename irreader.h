@@ -8,37 +8,97 @@
 #include <p8-platform/util/StringUtils.h>
 #include <p8-platform/threads/threads.h>
 
+#include "capture.h"
+#include "eventloop.h"
 #include "keyname.h"
+#include "keytable.h"
 #include "lircpp.h"
+#include "spscring.h"
 
+// Reads the receiver on its own thread and hands decoded keys through a
+// lock-free ring to a second thread that runs the callbacks, so a callback
+// that blocks on CEC never keeps the receiver from being read
 class IRReader : public P8PLATFORM::CThread
 {
 public:
     class Callback
     {
     public:
-        virtual void onReceive(const KeyName& key) = 0;
+        virtual void onReceive(const KeyName& key, LircPP::Event event) = 0;
+    };
+
+    struct Stats {
+        size_t depth;
+        size_t maxDepth;
+        uint64_t dispatched;
+        // Presses and repeats that found the ring full
+        uint64_t overflows;
+        // Releases dropped along with their press; the release of a press
+        // that made it in always does too
+        uint64_t releaseOverflows;
+        // Syscalls spent on the receiver for the last frame
+        unsigned long frameSyscalls;
     };
 public:
-    IRReader(const std::string& baseDir, const std::string& keyname, bool recordOnly = false);
+    // Received codes are mapped to the keys of keys, which may be nullptr
+    // when only recording
+    IRReader(const KeyTable::RemotePtr& keys, bool recordOnly = false);
     virtual ~IRReader(void) {}
 
     void setVerbose(bool v);
 
+    // Switch to another snapshot of the keys; takes effect from the next
+    // frame received
+    void setKeys(const KeyTable::RemotePtr& keys) { mLirc.setKeys(keys); }
+
+    // Write every raw sample received to a capture file
+    bool setCapture(const std::string& path);
+
     void addCallback(Callback* cb);
 
+    Stats stats() const;
+
     void cancel();
 
     void* Process(void) override;
 
 private:
+    struct Received {
+        KeyName key;
+        LircPP::Event event;
+        uint64_t time;
+    };
+
+    class Dispatcher : public P8PLATFORM::CThread
+    {
+    public:
+        Dispatcher(IRReader& reader) : mReader(reader) {}
+        void* Process(void) override { mReader.dispatch(); return nullptr; }
+
+    private:
+        IRReader& mReader;
+    };
+
+    void dispatch();
+
     std::atomic<bool> mVerbose;
     std::atomic<bool> mRunning;
 
     bool mRecordOnly;
     LircPP mLirc;
+    CaptureWriter mCapture;
 
     std::vector<Callback*> mCallbacks;
+
+    SpscRing<Received, 64> mRing;
+    EventNotifier mPending;
+    Dispatcher mDispatcher;
+    std::atomic<bool> mDispatching;
+
+    std::atomic<size_t> mMaxDepth;
+    std::atomic<uint64_t> mDispatched;
+    std::atomic<uint64_t> mOverflows;
+    std::atomic<uint64_t> mReleaseOverflows;
 };
 
 #endif // CECFORWARDER_IRREADER_H
\ No newline at end of file
@@ -0,0 +1,176 @@
+// Feeds a capture made with `cec-forwarder --capture` (or a raw mode2
+// stream) through the same framing and decoding as the live receiver.
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "capture.h"
+#include "lircpp.h"
+
+static void usage(const char* name)
+{
+    std::cerr << "Usage: " << name << " [--realtime] [--raw] [--quiet] [--keys <file>] <capture|->\n"
+        << "  --realtime  replay at the speed the samples were captured\n"
+        << "  --raw       input is a plain mode2 sample stream, not a capture\n"
+        << "  --quiet     only print the summary\n"
+        << "  --keys      key file to map decoded codes to key names\n";
+}
+
+// Write the capture's samples to fd as a raw mode2 stream, one write per
+// batch the receiver originally read together
+static void feed(CaptureReader& reader, int fd, bool realtime)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::vector<uint32_t> batch;
+    uint64_t batchTime = 0, firstTime = 0;
+    bool first = true;
+    Clock::time_point start = Clock::now();
+
+    auto flush = [&] {
+        if (batch.empty()) {
+            return;
+        }
+
+        if (realtime) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(batchTime - firstTime));
+        }
+
+        const char* data = reinterpret_cast<const char*>(batch.data());
+        size_t left = batch.size() * sizeof(uint32_t);
+        while (left > 0) {
+            ssize_t ret = write(fd, data, left);
+            if (ret <= 0) {
+                return;
+            }
+
+            data += ret;
+            left -= ret;
+        }
+
+        batch.clear();
+    };
+
+    uint32_t sample;
+    uint64_t time;
+    while (reader.next(sample, time)) {
+        if (first) {
+            firstTime = batchTime = time;
+            first = false;
+        }
+
+        if (time != batchTime) {
+            flush();
+            batchTime = time;
+        }
+
+        batch.push_back(sample);
+    }
+
+    flush();
+    close(fd);
+}
+
+int main(int argc, char* argv[])
+{
+    bool realtime = false, raw = false, quiet = false;
+    std::string keys, input;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--realtime") {
+            realtime = true;
+        } else if (a == "--raw") {
+            raw = true;
+        } else if (a == "--quiet") {
+            quiet = true;
+        } else if (a == "--keys" && i + 1 < argc) {
+            keys = argv[++i];
+        } else if (input.empty() && (a == "-" || a[0] != '-')) {
+            input = a;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (input.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    LircPP lirc(keys);
+    KeyTable::RemotePtr keyTable = lirc.keys();
+
+    CaptureReader reader;
+    std::thread feeder;
+    if (raw) {
+        int fd = (input == "-") ? dup(STDIN_FILENO) : open(input.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1 || !lirc.receiver().attach(fd)) {
+            std::cerr << "Failed opening " << input << "\n";
+            return 1;
+        }
+    } else {
+        int fds[2];
+        if (!reader.open(input) || socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == -1) {
+            return 1;
+        }
+
+        lirc.receiver().attach(fds[0]);
+        feeder = std::thread(feed, std::ref(reader), fds[1], realtime);
+    }
+
+    unsigned long frames = 0, repeats = 0, unmapped = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (!lirc.receiver().atEnd()) {
+        IRCode code;
+        if (!lirc.receiveRaw(code, 1000)) {
+            continue;
+        }
+
+        if (code.repeat) {
+            repeats++;
+            if (!quiet) {
+                std::cout << code.protocol->name << " repeat\n";
+            }
+
+            continue;
+        }
+
+        frames++;
+        KeyName key = (keyTable != nullptr) ? keyTable->keyFor(code) : KeyName();
+        if (key.value() == KeyName::KEY_INVALID) {
+            unmapped++;
+        }
+
+        if (!quiet) {
+            std::cout << code.protocol->name << ":0x" << std::hex << code.value << std::dec;
+            if (key.value() != KeyName::KEY_INVALID) {
+                std::cout << " " << key.name();
+            }
+
+            std::cout << "\n";
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (feeder.joinable()) {
+        feeder.join();
+    }
+
+    unsigned long total = frames + repeats + lirc.decodeFailures();
+    std::cerr << frames << " frames, " << repeats << " repeats, " << lirc.decodeFailures() << " failures, "
+        << unmapped << " without a key in " << seconds << "s";
+    if (total > 0 && !realtime) {
+        std::cerr << ", " << seconds * 1e6 / total << " us/frame";
+    }
+
+    std::cerr << "\n";
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+
+#include "irtransmitter.h"
+#include "latency.h"
+#include "log.h"
+#include "metrics.h"
+
+IRTransmitter::IRTransmitter(LircPP& lirc, size_t capacity, Policy policy)
+    : mLirc(lirc)
+    , mRunning(true)
+    , mSending(false)
+    , mPolicy(policy)
+    , mEntries(capacity > 0 ? capacity : 1)
+    , mHead(0)
+    , mCount(0)
+{
+    memset(&mStats, 0, sizeof(Stats));
+}
+
+void IRTransmitter::configure(size_t capacity, Policy policy)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mPolicy = policy;
+    if (capacity == 0 || capacity == mEntries.size()) {
+        return;
+    }
+
+    // Keep the newest capacity entries still pending, oldest of them
+    // first; any older ones are dropped
+    std::vector<Entry> entries(capacity);
+    size_t discarded = mCount - std::min(mCount, capacity);
+    size_t count = 0;
+    for (; count < mCount && count < capacity; count++) {
+        entries[count] = at(discarded + count);
+    }
+
+    mStats.dropped += discarded;
+
+    mEntries.swap(entries);
+    mHead = 0;
+    mCount = count;
+    mStats.depth = mCount;
+}
+
+IRTransmitter::Policy IRTransmitter::policyFromString(const std::string& name, Policy def)
+{
+    if (name == "drop") {
+        return POLICY_DROP;
+    } else if (name == "coalesce") {
+        return POLICY_COALESCE;
+    }
+
+    return def;
+}
+
+bool IRTransmitter::queue(const KeyName& key, const IRWaveform& waveform, const KeyTable::RemotePtr& keys, uint64_t origin)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mCount == mEntries.size()) {
+        if (mPolicy != POLICY_COALESCE || !coalesce(key)) {
+            mStats.dropped++;
+            return false;
+        }
+
+        if (mCount == mEntries.size()) {
+            // The key itself was folded into the last pending press
+            return true;
+        }
+    }
+
+    Entry& entry = at(mCount++);
+    entry.key = key;
+    entry.waveform = &waveform;
+    entry.keys = keys;
+    entry.origin = origin;
+    entry.queued = Clock::now();
+
+    mStats.depth = mCount;
+    if (mCount > mStats.maxDepth) {
+        mStats.maxDepth = mCount;
+    }
+
+    mCond.notify_one();
+    return true;
+}
+
+bool IRTransmitter::coalesce(const KeyName& key)
+{
+    if (at(mCount - 1).key == key) {
+        mStats.coalesced++;
+        return true;
+    }
+
+    // Collapse the first run of repeated keys to make room
+    for (size_t i = 0; i + 1 < mCount; i++) {
+        if (at(i).key == at(i + 1).key) {
+            for (size_t j = i + 1; j + 1 < mCount; j++) {
+                at(j) = at(j + 1);
+            }
+
+            at(mCount - 1).keys.reset();
+            mCount--;
+            mStats.coalesced++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+IRTransmitter::Stats IRTransmitter::stats()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+bool IRTransmitter::waitIdle(int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mIdle.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return !mRunning || (mCount == 0 && !mSending); });
+}
+
+void IRTransmitter::cancel()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRunning = false;
+    mCond.notify_one();
+    mIdle.notify_all();
+}
+
+void* IRTransmitter::Process()
+{
+    while (true) {
+        Entry entry;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCond.wait(lock, [this] { return !mRunning || mCount > 0; });
+            if (!mRunning) {
+                break;
+            }
+
+            // Moved out, so the slot doesn't keep the keys alive
+            entry = std::move(at(0));
+            mHead = (mHead + 1) % mEntries.size();
+            mCount--;
+            mSending = true;
+
+            uint64_t waitNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - entry.queued).count();
+            uint64_t waitUs = waitNs / 1000;
+            Latency::histogram(Latency::STAGE_QUEUE).record(waitNs);
+            mStats.depth = mCount;
+            mStats.dequeued++;
+            mStats.totalWaitUs += waitUs;
+            if (waitUs > mStats.maxWaitUs) {
+                mStats.maxWaitUs = waitUs;
+            }
+
+            LOG(DEBUG, "Transmitting %s after %lluus in queue, %zu pending", entry.key.name(),
+                static_cast<unsigned long long>(waitUs), mCount);
+        }
+
+        uint64_t start = Latency::now();
+        bool sent = mLirc.send(*entry.waveform);
+        if (sent) {
+            Metrics::keyTransmitted();
+
+            Latency::record(Latency::STAGE_TX, start);
+            if (entry.origin != 0) {
+                Latency::record(Latency::STAGE_CEC_TO_IR, entry.origin);
+            }
+        } else {
+            LOG(ERROR, "Failed sending %s", entry.key.name());
+            Metrics::txError();
+        }
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mSending = false;
+        if (mCount == 0) {
+            mIdle.notify_all();
+        }
+    }
+
+    return nullptr;
+}
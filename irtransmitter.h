@@ -0,0 +1,91 @@
+#ifndef CECFORWARDER_IRTRANSMITTER_H
+#define CECFORWARDER_IRTRANSMITTER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <p8-platform/os.h>
+#include <p8-platform/threads/threads.h>
+
+#include "keyname.h"
+#include "keytable.h"
+#include "lircpp.h"
+
+// Sends IR keys from its own thread so the libCEC callbacks only have to
+// queue them. The queue is bounded; what happens to a key that arrives
+// while it is full is decided by the policy.
+class IRTransmitter : public P8PLATFORM::CThread
+{
+public:
+    enum Policy {
+        // Drop the incoming key
+        POLICY_DROP,
+        // Fold repeats of the same key together to make room
+        POLICY_COALESCE,
+    };
+
+    struct Stats {
+        size_t depth;
+        size_t maxDepth;
+        uint64_t dequeued;
+        uint64_t dropped;
+        uint64_t coalesced;
+        uint64_t totalWaitUs;
+        uint64_t maxWaitUs;
+    };
+
+public:
+    IRTransmitter(LircPP& lirc, size_t capacity = 16, Policy policy = POLICY_COALESCE);
+    virtual ~IRTransmitter(void) {}
+
+    void configure(size_t capacity, Policy policy);
+
+    static Policy policyFromString(const std::string& name, Policy def = POLICY_COALESCE);
+
+    // waveform must come from keys, which is held on to until it has been
+    // sent. origin is when the press that led to this key came in, as a
+    // Latency::now() timestamp, or zero if it didn't come from CEC.
+    bool queue(const KeyName& key, const IRWaveform& waveform, const KeyTable::RemotePtr& keys, uint64_t origin = 0);
+
+    Stats stats();
+
+    // Wait until everything queued has been sent; false on timeout
+    bool waitIdle(int timeoutMs);
+
+    void cancel();
+
+    void* Process(void) override;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry {
+        KeyName key;
+        const IRWaveform* waveform;
+        KeyTable::RemotePtr keys;
+        uint64_t origin;
+        Clock::time_point queued;
+    };
+
+    Entry& at(size_t i) { return mEntries[(mHead + i) % mEntries.size()]; }
+    bool coalesce(const KeyName& key);
+
+    LircPP& mLirc;
+    bool mRunning;
+    bool mSending;
+    Policy mPolicy;
+
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    std::condition_variable mIdle;
+
+    std::vector<Entry> mEntries;
+    size_t mHead, mCount;
+
+    Stats mStats;
+};
+
+#endif // CECFORWARDER_IRTRANSMITTER_H
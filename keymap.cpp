@@ -0,0 +1,418 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "configfile.h"
+#include "irdecoder.h"
+#include "irencoder.h"
+#include "keymap.h"
+#include "log.h"
+
+static_assert(sizeof(unsigned int) == sizeof(uint32_t), "samples are stored as 32 bit values");
+
+static const char MAGIC[8] = {'C', 'E', 'C', 'K', 'M', 'A', 'P', '1'};
+
+struct Keymap::Header {
+    char magic[8];
+
+    // Sources, to tell when the keymap is stale
+    uint64_t keysSize;
+    int64_t keysMtime;
+    uint64_t configSize;
+    int64_t configMtime;
+    char configPath[256];
+
+    // What the indices stored were built against
+    uint32_t keyNames;
+    uint32_t keyNamesHash;
+    uint32_t protocolsHash;
+
+    uint32_t keyCount;
+    uint32_t repeatCount;
+    uint32_t hasCecKeys;
+    uint32_t sampleCount;
+    uint32_t reserved;
+
+    // Followed by keyCount Keys, repeatCount Repeats, CEC_CODES int32_t
+    // CEC keys if hasCecKeys, and sampleCount samples
+};
+
+
+// FNV-1a
+static uint32_t hash(uint32_t h, const char* str)
+{
+    for (; *str != '\0'; str++) {
+        h = (h ^ static_cast<unsigned char>(*str)) * 16777619U;
+    }
+
+    return (h ^ '\n') * 16777619U;
+}
+
+static uint32_t hash(uint32_t h, uint32_t value)
+{
+    for (int i = 0; i < 4; i++, value >>= 8) {
+        h = (h ^ (value & 0xFF)) * 16777619U;
+    }
+
+    return h;
+}
+
+static uint32_t keyNamesHash()
+{
+    uint32_t h = 2166136261U;
+    for (int i = 0; i < KeyName::KEY_COUNT; i++) {
+        h = hash(h, KeyName(static_cast<KeyName::Value>(i)).name());
+    }
+
+    return h;
+}
+
+// Covers the timings as well as the names, so a keymap whose prebuilt
+// waveforms no longer match the protocol table is rebuilt
+static uint32_t protocolsHash()
+{
+    uint32_t h = 2166136261U;
+    for (size_t i = 0; i < IRProtocol::sProtocolCount; i++) {
+        const IRProtocol& p = *IRProtocol::sProtocols[i];
+        h = hash(h, p.name);
+        const uint32_t fields[] = {
+            p.encoding, p.carrier, p.tolerance, p.headerPulse, p.headerSpace, p.repeatSpace,
+            p.zeroPulse, p.zeroSpace, p.onePulse, p.oneSpace, p.bits, p.trailerPulse,
+            p.period, p.minFrames, p.onePulseFirst, static_cast<uint32_t>(p.doubleBit),
+            p.fixedMask, p.fixedValue, p.toggleMask,
+        };
+
+        for (uint32_t field: fields) {
+            h = hash(h, field);
+        }
+    }
+
+    return h;
+}
+
+static uint32_t protocolIndex(const IRProtocol* protocol)
+{
+    for (size_t i = 0; i < IRProtocol::sProtocolCount; i++) {
+        if (IRProtocol::sProtocols[i] == protocol) {
+            return i;
+        }
+    }
+
+    return ~0U;
+}
+
+static bool source(const std::string& path, uint64_t& size, int64_t& mtime)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+
+    size = st.st_size;
+    mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    return true;
+}
+
+Keymap::Keymap()
+    : mMap(nullptr)
+    , mMapSize(0)
+    , mHeader(nullptr)
+    , mKeys(nullptr)
+    , mRepeats(nullptr)
+    , mCecKeys(nullptr)
+    , mSamples(nullptr)
+{
+}
+
+Keymap::~Keymap()
+{
+    release();
+}
+
+void Keymap::release()
+{
+    if (mMap != nullptr) {
+        munmap(mMap, mMapSize);
+        mMap = nullptr;
+        mMapSize = 0;
+    }
+
+    mBuffer.clear();
+    mHeader = nullptr;
+    mKeys = nullptr;
+    mRepeats = nullptr;
+    mCecKeys = nullptr;
+    mSamples = nullptr;
+}
+
+size_t Keymap::keyCount() const
+{
+    return (mHeader != nullptr) ? mHeader->keyCount : 0;
+}
+
+size_t Keymap::repeatCount() const
+{
+    return (mHeader != nullptr) ? mHeader->repeatCount : 0;
+}
+
+const int32_t* Keymap::cecKeys() const
+{
+    return mCecKeys;
+}
+
+std::string Keymap::configPath() const
+{
+    return (mCecKeys != nullptr) ? mHeader->configPath : "";
+}
+
+bool Keymap::build(const std::string& keysPath, const std::string& configPath)
+{
+    release();
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.keyNames = KeyName::KEY_COUNT;
+    header.keyNamesHash = keyNamesHash();
+    header.protocolsHash = protocolsHash();
+
+    if (!source(keysPath, header.keysSize, header.keysMtime)) {
+        LOG(ERROR, "Failed reading %s", keysPath.c_str());
+        return false;
+    }
+
+    ConfigFile config(keysPath);
+    if (!config.parse()) {
+        LOG(ERROR, "Failed parsing %s", keysPath.c_str());
+        return false;
+    }
+
+    std::vector<Key> keys;
+    std::vector<Repeat> repeats;
+    std::vector<unsigned int> samples;
+    std::vector<unsigned int> data;
+    IRDecoder decoder;
+
+    const ConfigFile::Section* section = config.getSection("Keys");
+    if (section != nullptr) {
+        for (auto it = section->begin(); it != section->end(); it++) {
+            KeyName key(it->key);
+            if (key.value() == KeyName::KEY_INVALID) {
+                continue;
+            }
+
+            IRCode code;
+            if (!IRCode::parse(it->value, code) || !IREncoder::encode(code, data)) {
+                LOG(WARNING, "Invalid IR code %s for %s", it->value, it->key);
+                continue;
+            }
+
+            // Match on whatever the receiver makes of our own waveform, so
+            // e.g. a NEC code without the inverted address byte reads as NECX
+            IRCode received = code;
+            IRCode decoded;
+            bool complete = false;
+            decoder.reset();
+            for (size_t i = 0; i < data.size() && !complete; i++) {
+                complete = decoder.push(i % 2 == 0, data[i], decoded);
+            }
+
+            if (complete || decoder.finish(decoded)) {
+                received = decoded;
+            }
+
+            keys.push_back(Key {key.value(), protocolIndex(code.protocol), protocolIndex(received.protocol),
+                                received.value, static_cast<uint32_t>(samples.size()), static_cast<uint32_t>(data.size())});
+            samples.insert(samples.end(), data.begin(), data.end());
+
+            uint32_t protocol = protocolIndex(code.protocol);
+            bool haveRepeat = false;
+            for (auto& r: repeats) {
+                haveRepeat = haveRepeat || r.protocol == protocol;
+            }
+
+            if (!haveRepeat && IREncoder::encodeRepeat(code.protocol, data)) {
+                repeats.push_back(Repeat {protocol, static_cast<uint32_t>(samples.size()), static_cast<uint32_t>(data.size())});
+                samples.insert(samples.end(), data.begin(), data.end());
+            }
+        }
+    }
+
+    std::vector<int32_t> cecKeys;
+    if (!configPath.empty()) {
+        ConfigFile forwarder(configPath);
+        if (configPath.size() >= sizeof(header.configPath) || !forwarder.parse() ||
+                !source(configPath, header.configSize, header.configMtime)) {
+            LOG(ERROR, "Failed parsing %s", configPath.c_str());
+            return false;
+        }
+
+        strncpy(header.configPath, configPath.c_str(), sizeof(header.configPath) - 1);
+        cecKeys.assign(CEC_CODES, KeyName::KEY_INVALID);
+        const ConfigFile::Section* cec = forwarder.getSection("Keys");
+        if (cec != nullptr) {
+            for (auto it = cec->begin(); it != cec->end(); it++) {
+                int code = std::atoi(it->key);
+                if (code >= 0 && code < static_cast<int>(CEC_CODES)) {
+                    cecKeys[code] = KeyName(it->value).value();
+                }
+            }
+        }
+    }
+
+    header.keyCount = keys.size();
+    header.repeatCount = repeats.size();
+    header.hasCecKeys = cecKeys.empty() ? 0 : 1;
+    header.sampleCount = samples.size();
+
+    auto append = [this](const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        mBuffer.insert(mBuffer.end(), bytes, bytes + size);
+    };
+
+    append(&header, sizeof(header));
+    append(keys.data(), keys.size() * sizeof(Key));
+    append(repeats.data(), repeats.size() * sizeof(Repeat));
+    append(cecKeys.data(), cecKeys.size() * sizeof(int32_t));
+    append(samples.data(), samples.size() * sizeof(unsigned int));
+
+    if (!attach(mBuffer.data(), mBuffer.size())) {
+        mBuffer.clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool Keymap::map(const std::string& path, const std::string& keysPath)
+{
+    release();
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+        close(fd);
+        return false;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    mMap = map;
+    mMapSize = st.st_size;
+    if (!attach(static_cast<const uint8_t*>(map), st.st_size)) {
+        LOG(WARNING, "Ignoring invalid keymap %s", path.c_str());
+        release();
+        return false;
+    }
+
+    uint64_t size;
+    int64_t mtime;
+    bool fresh = source(keysPath, size, mtime) && size == mHeader->keysSize && mtime == mHeader->keysMtime;
+    if (fresh && mCecKeys != nullptr) {
+        fresh = source(mHeader->configPath, size, mtime) && size == mHeader->configSize && mtime == mHeader->configMtime;
+    }
+
+    if (!fresh) {
+        LOG(NOTICE, "Ignoring stale keymap %s", path.c_str());
+        release();
+        return false;
+    }
+
+    return true;
+}
+
+bool Keymap::attach(const uint8_t* data, size_t size)
+{
+    static_assert(sizeof(Header) % 8 == 0, "the records that follow the header must stay aligned");
+
+    const Header* header = reinterpret_cast<const Header*>(data);
+    if (size < sizeof(Header) || memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            header->keyNames != KeyName::KEY_COUNT || header->keyNamesHash != keyNamesHash() ||
+            header->protocolsHash != protocolsHash() || header->configPath[sizeof(header->configPath) - 1] != '\0') {
+        return false;
+    }
+
+    size_t cecCount = header->hasCecKeys ? CEC_CODES : 0;
+    uint64_t expected = sizeof(Header) + static_cast<uint64_t>(header->keyCount) * sizeof(Key) +
+        static_cast<uint64_t>(header->repeatCount) * sizeof(Repeat) + cecCount * sizeof(int32_t) +
+        static_cast<uint64_t>(header->sampleCount) * sizeof(unsigned int);
+    if (expected != size) {
+        return false;
+    }
+
+    const Key* keys = reinterpret_cast<const Key*>(header + 1);
+    const Repeat* repeats = reinterpret_cast<const Repeat*>(keys + header->keyCount);
+    const int32_t* cecKeys = reinterpret_cast<const int32_t*>(repeats + header->repeatCount);
+    const unsigned int* samples = reinterpret_cast<const unsigned int*>(cecKeys + cecCount);
+
+    // Everything is checked once here, so users can index without checking
+    for (uint32_t i = 0; i < header->keyCount; i++) {
+        const Key& k = keys[i];
+        if (k.key < 0 || k.key >= KeyName::KEY_COUNT || k.protocol >= IRProtocol::sProtocolCount ||
+                k.receivedProtocol >= IRProtocol::sProtocolCount ||
+                static_cast<uint64_t>(k.offset) + k.length > header->sampleCount) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header->repeatCount; i++) {
+        const Repeat& r = repeats[i];
+        if (r.protocol >= IRProtocol::sProtocolCount || static_cast<uint64_t>(r.offset) + r.length > header->sampleCount) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < cecCount; i++) {
+        if (cecKeys[i] < KeyName::KEY_INVALID || cecKeys[i] >= KeyName::KEY_COUNT) {
+            return false;
+        }
+    }
+
+    mHeader = header;
+    mKeys = keys;
+    mRepeats = repeats;
+    mCecKeys = (cecCount > 0) ? cecKeys : nullptr;
+    mSamples = samples;
+    return true;
+}
+
+bool Keymap::write(const std::string& path) const
+{
+    if (mHeader == nullptr) {
+        return false;
+    }
+
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(mHeader);
+    size_t size = isMapped() ? mMapSize : mBuffer.size();
+
+    // Written aside and renamed, so a running daemon never maps half a file
+    std::string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        LOG(ERROR, "Failed opening %s", tmp.c_str());
+        return false;
+    }
+
+    bool ok = ::write(fd, data, size) == static_cast<ssize_t>(size);
+    ok = (close(fd) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        LOG(ERROR, "Failed writing %s", path.c_str());
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,90 @@
+#ifndef CECFORWARDER_KEYMAP_H
+#define CECFORWARDER_KEYMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "irprotocol.h"
+#include "keyname.h"
+
+// Everything derived from a key file, in one flat block: for every key the
+// code it is received as and its prebuilt transmit waveform, the repeat
+// waveform of every protocol in use, and optionally the CEC key table of
+// a forwarder config. Built from the text files, the block can be written
+// out and later mapped back in read-only and used in place.
+//
+// A compiled keymap records the size and modification time of its
+// sources, and which key names and protocols it was built against, and is
+// only used if all of those still match.
+class Keymap {
+public:
+    struct Key {
+        int32_t key;
+        // Protocol sent and received as, as indices into
+        // IRProtocol::sProtocols, and the value received
+        uint32_t protocol;
+        uint32_t receivedProtocol;
+        uint32_t receivedValue;
+        // Waveform, in samples()
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct Repeat {
+        uint32_t protocol;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    static const size_t CEC_CODES = 256;
+
+public:
+    Keymap();
+    ~Keymap();
+
+    // Parse a text key file, and the [Keys] section of a forwarder config
+    // if given
+    bool build(const std::string& keysPath, const std::string& configPath = "");
+
+    // Map a compiled keymap of keysPath; false if it is missing or stale
+    bool map(const std::string& path, const std::string& keysPath);
+
+    bool write(const std::string& path) const;
+
+    // Where the compiled form of a key file is looked for
+    static std::string compiledPath(const std::string& keysPath) { return keysPath + ".keymap"; }
+
+    bool isMapped() const { return mMap != nullptr; }
+
+    const Key* keys() const { return mKeys; }
+    size_t keyCount() const;
+    const Repeat* repeats() const { return mRepeats; }
+    size_t repeatCount() const;
+    const unsigned int* samples() const { return mSamples; }
+
+    // Key for each CEC user control code, KEY_INVALID where there is
+    // none; nullptr if there was no forwarder config
+    const int32_t* cecKeys() const;
+    // The forwarder config the CEC keys came from, empty if none
+    std::string configPath() const;
+
+private:
+    struct Header;
+
+    bool attach(const uint8_t* data, size_t size);
+    void release();
+
+    std::vector<uint8_t> mBuffer;
+    void* mMap;
+    size_t mMapSize;
+
+    const Header* mHeader;
+    const Key* mKeys;
+    const Repeat* mRepeats;
+    const int32_t* mCecKeys;
+    const unsigned int* mSamples;
+};
+
+#endif // CECFORWARDER_KEYMAP_H
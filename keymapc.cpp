@@ -0,0 +1,61 @@
+// Compiles a key file, and optionally the CEC key table of a forwarder
+// config, into a keymap the forwarder maps in at startup instead of parsing
+// and encoding the text files.
+
+#include <iostream>
+#include <string>
+
+#include "keymap.h"
+#include "log.h"
+
+static void usage(const char* name)
+{
+    std::cerr << "Usage: " << name << " [-o <output>] <key file> [forwarder config]\n"
+        << "  -o  where to write the keymap, by default next to the key file\n"
+        << "      where the forwarder looks for it\n";
+}
+
+int main(int argc, char* argv[])
+{
+    std::string output, keys, config;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (a[0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else if (keys.empty()) {
+            keys = a;
+        } else if (config.empty()) {
+            config = a;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (keys.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (output.empty()) {
+        output = Keymap::compiledPath(keys);
+    }
+
+    Keymap keymap;
+    if (!keymap.build(keys, config) || !keymap.write(output)) {
+        return 1;
+    }
+
+    size_t mapped = 0;
+    if (keymap.cecKeys() != nullptr) {
+        for (size_t i = 0; i < Keymap::CEC_CODES; i++) {
+            mapped += (keymap.cecKeys()[i] != KeyName::KEY_INVALID) ? 1 : 0;
+        }
+    }
+
+    LOG(NOTICE, "Wrote %zu keys and %zu CEC key codes to %s", keymap.keyCount(), mapped, output.c_str());
+    return 0;
+}
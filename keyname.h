@@ -1,63 +1,73 @@
 #ifndef CECFORWARDER_KEYS_H 
 #define CECFORWARDER_KEYS_H
 
+#include <functional>
 #include <string>
-#include <unordered_map>
+
+// Every key, in strict alphabetical order so names can be binary searched.
+// This is checked at compile time.
+#define KEYNAME_LIST(X) \
+    X(KEY_0) \
+    X(KEY_1) \
+    X(KEY_2) \
+    X(KEY_3) \
+    X(KEY_4) \
+    X(KEY_5) \
+    X(KEY_6) \
+    X(KEY_7) \
+    X(KEY_8) \
+    X(KEY_9) \
+    X(KEY_BACK) \
+    X(KEY_BLUE) \
+    X(KEY_CHANNELDOWN) \
+    X(KEY_CHANNELUP) \
+    X(KEY_DOWN) \
+    X(KEY_EPG) \
+    X(KEY_FASTFORWARD) \
+    X(KEY_GREEN) \
+    X(KEY_HOME) \
+    X(KEY_LAST) \
+    X(KEY_LEFT) \
+    X(KEY_MENU) \
+    X(KEY_MUTE) \
+    X(KEY_OK) \
+    X(KEY_OPTION) \
+    X(KEY_PAGEDOWN) \
+    X(KEY_PAGEUP) \
+    X(KEY_PLAYPAUSE) \
+    X(KEY_POWER) \
+    X(KEY_PVR) \
+    X(KEY_RADIO) \
+    X(KEY_RECORD) \
+    X(KEY_RED) \
+    X(KEY_REWIND) \
+    X(KEY_RIGHT) \
+    X(KEY_STOP) \
+    X(KEY_SUBTITLE) \
+    X(KEY_TEXT) \
+    X(KEY_UP) \
+    X(KEY_VOD) \
+    X(KEY_VOLUMEDOWN) \
+    X(KEY_VOLUMEUP) \
+    X(KEY_YELLOW)
 
 class KeyName {
 public:
     enum Value {
         KEY_INVALID = -1,
-        KEY_0,
-        KEY_1,
-        KEY_2,
-        KEY_3,
-        KEY_4,
-        KEY_5,
-        KEY_6,
-        KEY_7,
-        KEY_8,
-        KEY_9,
-        KEY_BACK,
-        KEY_BLUE,
-        KEY_CHANNELDOWN,
-        KEY_CHANNELUP,
-        KEY_DOWN,
-        KEY_EPG,
-        KEY_FASTFORWARD,
-        KEY_GREEN,
-        KEY_LAST,
-        KEY_LEFT,
-        KEY_MENU,
-        KEY_MUTE,
-        KEY_OK,
-        KEY_OPTION,
-        KEY_PAGEDOWN,
-        KEY_PAGEUP,
-        KEY_PLAYPAUSE,
-        KEY_POWER,
-        KEY_PVR,
-        KEY_RADIO,
-        KEY_RECORD,
-        KEY_RED,
-        KEY_REWIND,
-        KEY_RIGHT,
-        KEY_STOP,
-        KEY_SUBTITLE,
-        KEY_TEXT,
-        KEY_UP,
-        KEY_VOD,
-        KEY_VOLUMEDOWN,
-        KEY_VOLUMEUP,
-        KEY_YELLOW,
-        KEY_HOME,
+#define KEYNAME_ENUM(key) key,
+        KEYNAME_LIST(KEYNAME_ENUM)
+#undef KEYNAME_ENUM
+        KEY_COUNT
     };
 
 public:
     KeyName(const std::string& name);
+    KeyName(const char* name);
     KeyName(KeyName::Value v = KeyName::KEY_INVALID);
 
-    std::string name() const;
+    // Static string, empty for KEY_INVALID
+    const char* name() const;
     KeyName::Value value() const { return mValue; }
 
     operator KeyName::Value () const { return mValue; }
@@ -68,9 +78,9 @@ private:
     template<typename T>
     operator T () const;
 
-    KeyName::Value mValue;
+    static KeyName::Value lookup(const char* name);
 
-    static std::unordered_map<std::string, KeyName::Value> sKeyMap;
+    KeyName::Value mValue;
 };
 
 namespace std
@@ -0,0 +1,98 @@
+#include <algorithm>
+
+#include "keyrepeater.h"
+#include "log.h"
+#include "metrics.h"
+
+// A sender repeats User Control Pressed at least every 450ms while a key is
+// held; the key counts as released if that stops for longer than this
+static const std::chrono::milliseconds HOLD_TIMEOUT(550);
+// Allowed on top of the repeat delay for the first of those, which some
+// senders only start once their own repeat delay has passed
+static const std::chrono::milliseconds FIRST_HOLD_MARGIN(100);
+
+// Used for whatever the config leaves out
+static const unsigned int DEFAULT_DELAY_MS = 850;
+static const unsigned int DEFAULT_RATE_MS = 50;
+
+KeyRepeater::KeyRepeater(IRTransmitter& transmitter)
+    : mTransmitter(transmitter)
+    , mDelayMs(DEFAULT_DELAY_MS)
+    , mRateMs(DEFAULT_RATE_MS)
+    , mFrame(nullptr)
+    , mRepeat(nullptr)
+{
+}
+
+void KeyRepeater::setRepeat(unsigned int delayMs, unsigned int rateMs)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mDelayMs = (delayMs > 0) ? delayMs : DEFAULT_DELAY_MS;
+    mRateMs = (rateMs > 0) ? rateMs : DEFAULT_RATE_MS;
+}
+
+bool KeyRepeater::press(const KeyName& key, const KeyTable::RemotePtr& keys)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    Clock::time_point now = Clock::now();
+    mLastPress = now;
+    if (mKey == key) {
+        Metrics::repeatSuppressed();
+        return false;
+    }
+
+    mKey = key;
+    mPressed = now;
+    mKeys = keys;
+    mFrame = keys->waveform(key);
+    mRepeat = keys->repeatWaveform(key);
+    mLastSent = now;
+    mTimer.arm(mDelayMs, mRateMs);
+    return true;
+}
+
+void KeyRepeater::release()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    stop();
+}
+
+void KeyRepeater::stop()
+{
+    mTimer.disarm();
+    mKey = KeyName();
+    mKeys.reset();
+    mFrame = mRepeat = nullptr;
+}
+
+void KeyRepeater::expired()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    // Expirations missed while busy are not made up for
+    if (mTimer.read() == 0 || mFrame == nullptr) {
+        return;
+    }
+
+    Clock::time_point now = Clock::now();
+    Clock::duration timeout = HOLD_TIMEOUT;
+    if (mLastPress == mPressed) {
+        timeout = std::max<Clock::duration>(timeout, std::chrono::milliseconds(mDelayMs) + FIRST_HOLD_MARGIN);
+    }
+
+    if (now - mLastPress > timeout) {
+        LOG(INFO, "No release for %s, stopping repeat", mKey.name());
+        stop();
+        return;
+    }
+
+    // Repeat frames only mean something to a receiver that still holds
+    // the key, so after a longer pause start over with a full frame
+    std::chrono::microseconds window(mFrame->protocol->period * 3 / 2);
+    const IRWaveform* waveform = (mRepeat != nullptr && now - mLastSent < window) ? mRepeat : mFrame;
+
+    mTransmitter.queue(mKey, *waveform, mKeys);
+    mLastSent = now;
+    Metrics::repeatGenerated();
+}
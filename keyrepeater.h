@@ -0,0 +1,56 @@
+#ifndef CECFORWARDER_KEYREPEATER_H
+#define CECFORWARDER_KEYREPEATER_H
+
+#include <chrono>
+#include <mutex>
+
+#include "eventloop.h"
+#include "irencoder.h"
+#include "irtransmitter.h"
+#include "keyname.h"
+#include "keytable.h"
+
+// Autorepeat for a held CEC key. Once pressed, the key is repeated after
+// the repeat delay and then at the repeat rate from a monotonic timer,
+// independent of how often the TV resends the press, until it is released.
+class KeyRepeater {
+public:
+    KeyRepeater(IRTransmitter& transmitter);
+
+    // Zero for either restores its default, so that a reloaded config
+    // without it doesn't keep the old value
+    void setRepeat(unsigned int delayMs, unsigned int rateMs);
+
+    // Start repeating key, which must have a waveform in keys; its repeat
+    // frame is sent while the key is held, if the protocol has one.
+    // Returns false if the key was already held, which only extends the
+    // hold.
+    bool press(const KeyName& key, const KeyTable::RemotePtr& keys);
+    void release();
+
+    // Handle the timer firing; fd() is readable when it has
+    void expired();
+    int fd() const { return mTimer.fd(); }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void stop();
+
+    IRTransmitter& mTransmitter;
+    EventTimer mTimer;
+    unsigned int mDelayMs, mRateMs;
+
+    std::mutex mMutex;
+    KeyName mKey;
+    // Held on to for as long as the key is, as the frames live in it
+    KeyTable::RemotePtr mKeys;
+    const IRWaveform* mFrame;
+    const IRWaveform* mRepeat;
+    // When the key was first pressed, and last pressed again
+    Clock::time_point mPressed;
+    Clock::time_point mLastPress;
+    Clock::time_point mLastSent;
+};
+
+#endif // CECFORWARDER_KEYREPEATER_H
@@ -0,0 +1,98 @@
+#include <algorithm>
+
+#include "keytable.h"
+#include "latency.h"
+#include "log.h"
+
+const IRWaveform* KeyTable::Remote::waveform(const KeyName& key) const
+{
+    if (key.value() == KeyName::KEY_INVALID || mWaveforms[key.value()].protocol == nullptr) {
+        return nullptr;
+    }
+
+    return &mWaveforms[key.value()];
+}
+
+const IRWaveform* KeyTable::Remote::repeatWaveform(const KeyName& key) const
+{
+    if (key.value() == KeyName::KEY_INVALID || mRepeatWaveforms[key.value()].protocol == nullptr) {
+        return nullptr;
+    }
+
+    return &mRepeatWaveforms[key.value()];
+}
+
+KeyTable::Ptr KeyTable::load(const std::vector<std::string>& paths)
+{
+    std::shared_ptr<KeyTable> table(new KeyTable());
+
+    std::vector<std::string> unique;
+    for (auto& path: paths) {
+        if (std::find(unique.begin(), unique.end(), path) == unique.end()) {
+            unique.push_back(path);
+        }
+    }
+
+    // Sized up front, the remotes can point into it
+    table->mWaveforms.assign(unique.size() * KeyName::KEY_COUNT * 2, IRWaveform {nullptr, 0, nullptr, 0});
+
+    for (size_t r = 0; r < unique.size(); r++) {
+        std::unique_ptr<Remote> remote(new Remote());
+        remote->mPath = unique[r];
+
+        IRWaveform* waveforms = &table->mWaveforms[r * KeyName::KEY_COUNT * 2];
+        IRWaveform* repeats = waveforms + KeyName::KEY_COUNT;
+        remote->mWaveforms = waveforms;
+        remote->mRepeatWaveforms = repeats;
+
+        uint64_t start = Latency::now();
+        Keymap& keymap = remote->mKeymap;
+        bool mapped = keymap.map(Keymap::compiledPath(remote->mPath), remote->mPath);
+        if (!mapped && !keymap.build(remote->mPath)) {
+            return nullptr;
+        }
+
+        for (size_t i = 0; i < keymap.keyCount(); i++) {
+            const Keymap::Key& k = keymap.keys()[i];
+            const IRProtocol* protocol = IRProtocol::sProtocols[k.protocol];
+            waveforms[k.key] = IRWaveform {protocol, protocol->carrier, keymap.samples() + k.offset, k.length};
+
+            for (size_t j = 0; j < keymap.repeatCount(); j++) {
+                const Keymap::Repeat& rep = keymap.repeats()[j];
+                if (rep.protocol == k.protocol) {
+                    repeats[k.key] = IRWaveform {protocol, protocol->carrier, keymap.samples() + rep.offset, rep.length};
+                }
+            }
+
+            KeyName key(static_cast<KeyName::Value>(k.key));
+            KeyName existing;
+            IRCode code = {IRProtocol::sProtocols[k.receivedProtocol], k.receivedValue, false};
+            if (!remote->mIndex.insert(code, key, &existing)) {
+                LOG(WARNING, "Duplicate IR code for %s and %s, keeping %s", key.name(), existing.name(), existing.name());
+            }
+        }
+
+        LOG(INFO, "Loaded %zu keys from %s%s in %lluus", keymap.keyCount(), remote->mPath.c_str(),
+            mapped ? " (compiled)" : "", static_cast<unsigned long long>((Latency::now() - start) / 1000));
+
+        table->mRemotes.push_back(std::move(remote));
+    }
+
+    return table;
+}
+
+KeyTable::RemotePtr KeyTable::remote(const Ptr& table, const std::string& path)
+{
+    if (table == nullptr) {
+        return nullptr;
+    }
+
+    for (auto& remote: table->mRemotes) {
+        if (remote->mPath == path) {
+            // Shares the table's reference count
+            return RemotePtr(table, remote.get());
+        }
+    }
+
+    return nullptr;
+}
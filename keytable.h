@@ -0,0 +1,74 @@
+#ifndef CECFORWARDER_KEYTABLE_H
+#define CECFORWARDER_KEYTABLE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "codeindex.h"
+#include "irencoder.h"
+#include "keymap.h"
+#include "keyname.h"
+
+// The keys of every remote in use, loaded once however many users a key
+// file has. Immutable once loaded: users hold a snapshot of the remote
+// they need, which keeps the whole table alive, and a reload builds a new
+// table for them to switch to.
+//
+// Waveforms of all remotes live in one flat array, indexed by remote and
+// KeyName::Value; received codes are looked up in a per-remote CodeIndex.
+class KeyTable {
+public:
+    class Remote {
+    public:
+        const std::string& path() const { return mPath; }
+
+        // Where the keys came from: the compiled keymap, or the parsed
+        // key file
+        const Keymap& keymap() const { return mKeymap; }
+
+        // The prebuilt pulse train for a key, or nullptr if it has no
+        // code. Valid for as long as the snapshot it came from is held.
+        const IRWaveform* waveform(const KeyName& key) const;
+
+        // The frame sent in place of the full one while the key is held,
+        // or nullptr if its protocol simply repeats the full frame
+        const IRWaveform* repeatWaveform(const KeyName& key) const;
+
+        // The key a decoded code is mapped to, KEY_INVALID if none
+        KeyName keyFor(const IRCode& code) const { return mIndex.find(code); }
+
+    private:
+        friend class KeyTable;
+
+        std::string mPath;
+        Keymap mKeymap;
+        // KEY_COUNT entries each, in the table's array; protocol is
+        // nullptr for keys without a code
+        const IRWaveform* mWaveforms;
+        const IRWaveform* mRepeatWaveforms;
+        CodeIndex mIndex;
+    };
+
+    typedef std::shared_ptr<const KeyTable> Ptr;
+    typedef std::shared_ptr<const Remote> RemotePtr;
+
+public:
+    // Load every key file, using its compiled keymap if that is up to
+    // date; nullptr if any of them fails
+    static Ptr load(const std::vector<std::string>& paths);
+
+    // A snapshot of the remote loaded from path, which shares ownership
+    // of the table; nullptr if there is none
+    static RemotePtr remote(const Ptr& table, const std::string& path);
+
+private:
+    KeyTable() {}
+    KeyTable(const KeyTable&);
+    KeyTable& operator=(const KeyTable&);
+
+    std::vector<std::unique_ptr<Remote>> mRemotes;
+    std::vector<IRWaveform> mWaveforms;
+};
+
+#endif // CECFORWARDER_KEYTABLE_H
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <iomanip>
+
+#include "latency.h"
+
+// Zero-initialised before anything runs, no constructors involved
+static LatencyHistogram sHistograms[Latency::STAGE_COUNT];
+
+unsigned int LatencyHistogram::bucket(uint64_t ns)
+{
+    if (ns < (1U << SUB_BITS)) {
+        return ns;
+    }
+
+    unsigned int exponent = 63 - __builtin_clzll(ns);
+    unsigned int sub = (ns >> (exponent - SUB_BITS)) & ((1U << SUB_BITS) - 1);
+    return ((exponent - SUB_BITS + 1) << SUB_BITS) + sub;
+}
+
+uint64_t LatencyHistogram::lowerBound(unsigned int bucket)
+{
+    if (bucket < (1U << SUB_BITS)) {
+        return bucket;
+    }
+
+    unsigned int exponent = (bucket >> SUB_BITS) + SUB_BITS - 1;
+    uint64_t sub = bucket & ((1U << SUB_BITS) - 1);
+    return ((1ULL << SUB_BITS) + sub) << (exponent - SUB_BITS);
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+    mBuckets[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    mCount.fetch_add(1, std::memory_order_relaxed);
+    mSum.fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t max = mMax.load(std::memory_order_relaxed);
+    while (ns > max && !mMax.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const
+{
+    uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t target = static_cast<uint64_t>(fraction * total);
+    target = (target < total) ? target + 1 : total;
+
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < BUCKETS; i++) {
+        seen += mBuckets[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            uint64_t upper = (i + 1 < BUCKETS) ? lowerBound(i + 1) - 1 : ~0ULL;
+            // Never claim more than was actually seen
+            return std::min(upper, max());
+        }
+    }
+
+    return max();
+}
+
+namespace Latency {
+
+LatencyHistogram& histogram(Stage stage)
+{
+    return sHistograms[stage];
+}
+
+const char* stageName(Stage stage)
+{
+    switch (stage) {
+    case STAGE_DECODE: return "decode";
+    case STAGE_LOOKUP: return "lookup";
+    case STAGE_IR_TO_CEC: return "ir-to-cec";
+    case STAGE_CEC_TO_QUEUE: return "cec-to-queue";
+    case STAGE_QUEUE: return "queue";
+    case STAGE_TX: return "tx";
+    case STAGE_CEC_TO_IR: return "cec-to-ir";
+    default: return "unknown";
+    }
+}
+
+void dump(std::ostream& out)
+{
+    out << std::left << std::setw(14) << "Latency (us)" << std::right
+        << std::setw(10) << "count" << std::setw(12) << "p50" << std::setw(12) << "p99" << std::setw(12) << "max" << "\n";
+
+    out << std::fixed << std::setprecision(1);
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        const LatencyHistogram& h = histogram(static_cast<Stage>(i));
+        out << std::left << std::setw(14) << stageName(static_cast<Stage>(i)) << std::right
+            << std::setw(10) << h.count()
+            << std::setw(12) << h.percentile(0.5) / 1000.0
+            << std::setw(12) << h.percentile(0.99) / 1000.0
+            << std::setw(12) << h.max() / 1000.0 << "\n";
+    }
+
+    out.unsetf(std::ios::floatfield);
+}
+
+}
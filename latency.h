@@ -0,0 +1,79 @@
+#ifndef CECFORWARDER_LATENCY_H
+#define CECFORWARDER_LATENCY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Fixed-size histogram of durations in nanoseconds. Buckets are spaced
+// logarithmically, eight to each power of two, so any value is accurate to
+// within 12.5%. Recording is a couple of relaxed atomic operations and can
+// be done from any thread.
+class LatencyHistogram {
+public:
+    void record(uint64_t ns);
+
+    uint64_t count() const { return mCount.load(std::memory_order_relaxed); }
+    uint64_t max() const { return mMax.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return mSum.load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the given fraction of values
+    uint64_t percentile(double fraction) const;
+
+    static const unsigned int SUB_BITS = 3;
+    static const unsigned int BUCKETS = (64 - SUB_BITS + 1) << SUB_BITS;
+
+    static unsigned int bucket(uint64_t ns);
+    static uint64_t lowerBound(unsigned int bucket);
+
+private:
+    std::atomic<uint64_t> mBuckets[BUCKETS];
+    std::atomic<uint64_t> mCount;
+    std::atomic<uint64_t> mSum;
+    std::atomic<uint64_t> mMax;
+};
+
+// Per-stage latency of a key on its way through the forwarder
+namespace Latency {
+
+enum Stage {
+    // IR: last sample off the receiver to decoded code
+    STAGE_DECODE,
+    // IR: decoded code to key
+    STAGE_LOOKUP,
+    // IR: key event through the CEC side
+    STAGE_IR_TO_CEC,
+    // CEC: frame from libCEC to key queued for transmission
+    STAGE_CEC_TO_QUEUE,
+    // CEC: time spent in the transmit queue
+    STAGE_QUEUE,
+    // CEC: transmission, up to the end of the write to the device
+    STAGE_TX,
+    // CEC: frame from libCEC to the end of the IR write
+    STAGE_CEC_TO_IR,
+    STAGE_COUNT,
+};
+
+// Monotonic timestamp in nanoseconds
+inline uint64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+LatencyHistogram& histogram(Stage stage);
+
+// Record the time from start to now
+inline void record(Stage stage, uint64_t start)
+{
+    histogram(stage).record(now() - start);
+}
+
+const char* stageName(Stage stage);
+
+// Print count, p50, p99 and max for every stage
+void dump(std::ostream& out);
+
+}
+
+#endif // CECFORWARDER_LATENCY_H
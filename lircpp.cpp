@@ -1,38 +1,47 @@
-#include <iostream>
 #include <fstream>
-#include <bitset>
-#include <cmath>
+#include <algorithm>
 
 #include <cerrno>
 #include <fcntl.h>
 #include <unistd.h>
-#include <poll.h>
 #include <sys/ioctl.h>
 #include <linux/lirc.h>
 
-#include "config.h"
+#include "latency.h"
+#include "log.h"
+#include "metrics.h"
 #include "lircpp.h"
 
 LircPP::LircPP(const std::string& keyspath)
-    : mVerbose(false)
+    : LircPP(KeyTable::RemotePtr())
 {
-    HueConfig config(keyspath);
-    if (!config.parse()) {
-        std::cerr << "Failed parsing config\n";
-        return;
+    // Decoding only, nothing to map to or send
+    if (!keyspath.empty()) {
+        setKeys(KeyTable::remote(KeyTable::load({keyspath}), keyspath));
     }
+}
 
-    HueConfigSection* section = config.getSection("Keys");
-    if (section == nullptr) {
-        return;
-    }
+LircPP::LircPP(const KeyTable::RemotePtr& keys)
+    : mVerbose(false)
+    , mFrameSyscalls(0)
+    , mDecodeFailures(0)
+    , mFrameGap(19000)
+    , mFrameTimeoutMs(5000)
+    , mTxFd(-1)
+    , mTxCarrier(0)
+    , mKeys(keys)
+    , mHeldFrames(0)
+{
+    // Have the receiver report the end of a frame as soon as the longest
+    // space any of the active protocols can contain has passed
+    mFrameGap = mDecoder.maxSpace() + 1000;
+    mFrameTimeoutMs = (mFrameGap * 2 + 999) / 1000;
+    mRx.setTimeout(mFrameGap);
+}
 
-    for (auto it = section->begin(); it != section->end(); it++) {
-        KeyName key(it->first);
-        if (key != KeyName::KEY_INVALID) {
-            mData[key] = strtoul(it->second.c_str(), nullptr, 0);
-        }
-    }
+LircPP::~LircPP()
+{
+    closeTx();
 }
 
 void LircPP::setVerbose(bool v)
@@ -40,290 +49,327 @@ void LircPP::setVerbose(bool v)
     mVerbose = v;
 }
 
-bool LircPP::receive(KeyName& key)
+void LircPP::setKeys(const KeyTable::RemotePtr& keys)
 {
-    uint32_t k;
-    if (receiveRaw(k)) {
-        for (auto data: mData) {
-            if (data.second == k) {
-                key = data.first;
-                return true;
-            }
-        }
-    }
+    std::atomic_store(&mKeys, keys);
+}
 
-    return false;
+KeyTable::RemotePtr LircPP::keys() const
+{
+    return std::atomic_load(&mKeys);
 }
 
-bool LircPP::receiveRaw(uint32_t& value)
+bool LircPP::receive(KeyName& key, Event& event)
 {
-    int fd = open("/dev/lirc-rx", O_RDONLY | O_CLOEXEC);
-    if (fd == -1) {
-        return false;
+    if (mPending != KeyName::KEY_INVALID) {
+        key = mPending;
+        event = EVENT_PRESS;
+        hold(key, 1);
+        mPending = KeyName::KEY_INVALID;
+        return true;
     }
 
-    struct pollfd fds[1];
-    fds[0].fd = fd;
-    fds[0].events = POLLIN;
-
-    int mode = LIRC_MODE_MODE2;
-    if (ioctl(fd, LIRC_SET_REC_MODE, &mode)) {
-        return false;
+    // While a key is held, only wait as long as its next repeat may take
+    int timeoutMs = 5000;
+    if (mHeld != KeyName::KEY_INVALID) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(mHeldUntil - Clock::now()).count();
+        timeoutMs = std::max<int>(0, left);
     }
 
-    std::vector<std::pair<bool, unsigned int> > data;
+    IRCode code;
+    if (receiveRaw(code, timeoutMs)) {
+        if (code.repeat) {
+            if (mHeld.value() == KeyName::KEY_INVALID) {
+                return false;
+            }
 
-    std::array<unsigned, 512> buf;
+            key = mHeld;
+            event = EVENT_REPEAT;
+            hold(key, mHeldFrames + 1);
+            return true;
+        }
 
-    bool reading = true;
-    while (reading) {
-        if (poll(fds, 1, 5000) != 1) {
-            break;
+        uint64_t start = Latency::now();
+        KeyTable::RemotePtr keys = this->keys();
+        KeyName received = (keys != nullptr) ? keys->keyFor(code) : KeyName();
+        Latency::record(Latency::STAGE_LOOKUP, start);
+        if (received.value() == KeyName::KEY_INVALID) {
+            return false;
         }
 
-        ssize_t ret = read(fd, buf.data(), buf.size() * sizeof(unsigned));
-        if (ret < 0 && errno == EINTR) {
-            continue;
+        if (received == mHeld) {
+            // Protocols without repeat frames resend the full frame, some
+            // of them several times for a single press
+            hold(received, mHeldFrames + 1);
+            if (mHeldFrames <= code.protocol->minFrames) {
+                return false;
+            }
+
+            key = received;
+            event = EVENT_REPEAT;
+            return true;
         }
 
-        if (ret == 0 || ret % sizeof(unsigned) != 0) {
-            return false;
+        if (mHeld != KeyName::KEY_INVALID) {
+            // Release what was held before reporting the new key
+            key = mHeld;
+            event = EVENT_RELEASE;
+            mHeld = KeyName::KEY_INVALID;
+            mPending = received;
+            return true;
         }
 
-        for (int i = 0; i < ret / sizeof(unsigned); i++) {
-            unsigned val = buf[i] & LIRC_VALUE_MASK;
-            unsigned msg = buf[i] & LIRC_MODE2_MASK;
+        key = received;
+        event = EVENT_PRESS;
+        hold(received, 1);
+        return true;
+    }
+
+    if (mHeld != KeyName::KEY_INVALID && Clock::now() >= mHeldUntil) {
+        key = mHeld;
+        event = EVENT_RELEASE;
+        mHeld = KeyName::KEY_INVALID;
+        return true;
+    }
 
-            if (data.size() == 0 && msg == LIRC_MODE2_SPACE) {
-                continue;
-            }
+    return false;
+}
 
-            if ((msg == LIRC_MODE2_TIMEOUT ||
-                (msg == LIRC_MODE2_SPACE && val > 19000))) {
-                reading = false;
+void LircPP::hold(const KeyName& key, unsigned int frames)
+{
+    // Give the remote one and a half frame periods to send the next repeat
+    KeyTable::RemotePtr keys = this->keys();
+    const IRWaveform* w = (keys != nullptr) ? keys->waveform(key) : nullptr;
+    unsigned int period = (w != nullptr) ? w->protocol->period : 110000;
+
+    mHeld = key;
+    mHeldFrames = frames;
+    mHeldUntil = Clock::now() + std::chrono::microseconds(period * 3 / 2);
+}
+
+bool LircPP::receiveRaw(IRCode& code, int timeoutMs)
+{
+    unsigned long syscalls = mRx.syscalls();
+
+    // Wait as long as it takes for a frame to start, but once one has, stop
+    // waiting as soon as the receiver has been idle past the frame gap
+    bool inFrame = false;
+    bool decoded = false;
+
+    unsigned sample;
+    uint64_t sampleTime = 0;
+    unsigned int samples = 0;
+    while (mRx.next(sample, inFrame ? mFrameTimeoutMs : timeoutMs)) {
+        sampleTime = Latency::now();
+        unsigned val = sample & LIRC_VALUE_MASK;
+        unsigned msg = sample & LIRC_MODE2_MASK;
+
+        if (msg == LIRC_MODE2_TIMEOUT || (msg == LIRC_MODE2_SPACE && val > mFrameGap)) {
+            if (inFrame) {
                 break;
             }
 
-            if (msg == LIRC_MODE2_PULSE || msg == LIRC_MODE2_SPACE) {
-                bool add = true;
-                bool pulse = msg == LIRC_MODE2_PULSE;
-                if (data.size() > 0) {
-                    if ((data.back().first && pulse) || (!data.back().first && !pulse)) {
-                        data.back().second += val;
-                        add = false;
-                    }
-                }
-
-                if (add) {
-                    data.push_back({pulse, val});
-                }
-            }
+            continue;
         }
-    }
 
-    close(fd);
+        if (msg != LIRC_MODE2_PULSE && msg != LIRC_MODE2_SPACE) {
+            continue;
+        }
 
-    std::vector<unsigned int> flattened;
-    for (auto p: data) {
-        flattened.push_back(p.second);
-    }
+        bool pulse = msg == LIRC_MODE2_PULSE;
+        if (!inFrame && !pulse) {
+            continue;
+        }
 
-    return dataToKey(flattened, value);
-}
+        inFrame = true;
+        samples++;
+        if (mVerbose) {
+            mFrame.push_back(val);
+        }
 
-bool LircPP::send(const KeyName& key)
-{
-    if (mData.find(key) == mData.end()) {
-        return false;
+        if (dataToKey(pulse, val, code)) {
+            decoded = true;
+            break;
+        }
     }
 
-    int fd = open("/dev/lirc-tx", O_WRONLY | O_CLOEXEC);
-    if (fd == -1) {
-        return false;
+    // Some frames are only complete once the receiver goes idle
+    if (!decoded && inFrame) {
+        decoded = mDecoder.finish(code);
     }
 
-    int mode = LIRC_MODE_PULSE;
-    if (ioctl(fd, LIRC_SET_SEND_MODE, &mode)) {
-        return false;
+    if (decoded) {
+        Latency::record(Latency::STAGE_DECODE, sampleTime);
+        Metrics::irFrame(code);
+    } else if (samples > 1) {
+        // A lone trailer after an early decode isn't a failure
+        Metrics::irDecodeFailure();
+        mDecodeFailures++;
     }
 
-    std::vector<unsigned int> sendData;
-    sendData.push_back(9000);
-    sendData.push_back(4500);
-
-    uint32_t value = mData[key];
-    for (uint32_t i = 0; i < 32; i++) {
-        sendData.push_back(563);
-        if ((value >> (32 - i - 1)) & 1U) {
-            sendData.push_back(1687);
-        } else {
-            sendData.push_back(563);
-        }
-    }
+    unsigned long frameSyscalls = mRx.syscalls() - syscalls;
+    mFrameSyscalls.store(frameSyscalls, std::memory_order_relaxed);
 
-    sendData.push_back(563);
+    if (!inFrame) {
+        return false;
+    }
 
     if (mVerbose) {
-        std::cout << "Sending NEC IR:\n";
-        for (uint32_t i = 0; i < sendData.size(); i++) {
-            if (i % 2 == 0) {
-                std::cout << "pulse ";
-            } else {
-                std::cout << "space ";
+        // A lone trailer after an early decode isn't worth reporting
+        if (!decoded && mFrame.size() > 1) {
+            LOG(DEBUG, "Unhandled raw IR:");
+            for (uint32_t i = 0; i < mFrame.size(); i++) {
+                LOG(DEBUG, "%u", mFrame[i]);
             }
 
-            std::cout << sendData[i] << "\n";
+            LOG(DEBUG, "IR Done");
         }
-    }
 
-    if (write(fd, sendData.data(), sendData.size() * sizeof(unsigned int)) <= 0) {
-        return false;
+        LOG(DEBUG, "IR frame used %lu syscalls", frameSyscalls);
+        mFrame.clear();
     }
 
-    close(fd);
-    return true;
+    return decoded;
 }
 
-bool LircPP::checkTarget(unsigned int value, unsigned int target)
+bool LircPP::send(const KeyName& key)
 {
-    float diff = 1.0f - (value / static_cast<float>(target));
-    return std::abs(floor(diff * 100.0f)) < 25;
+    KeyTable::RemotePtr keys = this->keys();
+    const IRWaveform* w = (keys != nullptr) ? keys->waveform(key) : nullptr;
+    return (w != nullptr) ? send(*w) : false;
 }
 
-bool LircPP::dataToKey(const std::vector<unsigned int>& data, uint32_t &value)
+bool LircPP::send(const IRWaveform& waveform)
 {
-    value = 0;
-    if (data.size() < 5) {
-        if (mVerbose) {
-            std::cout << "Unhandled IR data with size " << data.size() << "\n";
+    const unsigned int* sendData = waveform.data;
+    if (mVerbose) {
+        LOG(DEBUG, "Sending %s IR:", waveform.protocol->name);
+        for (uint32_t i = 0; i < waveform.size; i++) {
+            LOG(DEBUG, "%s %u", (i % 2 == 0) ? "pulse" : "space", sendData[i]);
         }
+    }
 
+    if (!openTx()) {
         return false;
     }
 
-    if (dataToKeyNEC(data, value)) {
-        return true;
-    }
+    if (!mTxPath.empty()) {
+        mTxSamples.clear();
+        for (uint32_t i = 0; i < waveform.size; i++) {
+            mTxSamples.push_back(sendData[i] | ((i % 2 == 0) ? LIRC_MODE2_PULSE : LIRC_MODE2_SPACE));
+        }
+
+        mTxSamples.push_back(LIRC_MODE2_TIMEOUT | mFrameGap);
 
-    if (dataToKeyRC5(data, value)) {
+        ssize_t size = mTxSamples.size() * sizeof(unsigned int);
+        if (write(mTxFd, mTxSamples.data(), size) != size) {
+            LOG(ERROR, "Failed writing to %s", mTxPath.c_str());
+            closeTx();
+            return false;
+        }
+
+        // The device only returns once the waveform is out; take as long
+        // so the queue sees the same back pressure
+        unsigned int duration = 0;
+        for (size_t i = 0; i < waveform.size; i++) {
+            duration += sendData[i];
+        }
+
+        usleep(duration);
         return true;
     }
 
-    if (mVerbose) {
-        std::cout << "Unhandled raw IR:\n";
-        for (uint32_t i = 0; i < data.size(); i++) {
-            std::cout << data[i] << "\n";
-        }
+    // Not every transmitter can change its carrier; send regardless, and
+    // only ask again when the protocol changes
+    if (waveform.carrier != mTxCarrier) {
+        unsigned int carrier = waveform.carrier;
+        ioctl(mTxFd, LIRC_SET_SEND_CARRIER, &carrier);
+        mTxCarrier = waveform.carrier;
+    }
 
-        std::cout << "IR Done\n";
+    ssize_t size = waveform.size * sizeof(unsigned int);
+    if (write(mTxFd, sendData, size) != size) {
+        LOG(ERROR, "Failed writing to /dev/lirc-tx, reopening");
+        closeTx();
+        return false;
     }
 
-    return false;
+    return true;
 }
 
-bool LircPP::dataToKeyNEC(const std::vector<unsigned int>& data, uint32_t& value)
+bool LircPP::setTransmitFile(const std::string& path)
 {
-    // Header
-    if (!checkTarget(data[0], 9000) || !checkTarget(data[1], 4500)) {
+    closeTx();
+    mTxPath = path;
+
+    // Created up front, so a file left from an earlier run never passes
+    // for this one's output
+    mTxFd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mTxFd == -1) {
+        LOG(ERROR, "Failed opening %s", path.c_str());
         return false;
     }
-    
-    std::bitset<32> bits;
-    for (unsigned int i = 2, shift = 31; i < data.size() - 1; i += 2, shift--) {
-        unsigned int pulse = data[i];
-        unsigned int space = data[i + 1];
-        if (!checkTarget(pulse, 563)) {
-            return false;
-        }
 
-        if (checkTarget(space, 563)) {
-            bits[shift] = 0;
-        } else if (checkTarget(space, 1687)) {
-            bits[shift] = 1;
-        } else {
-            return false;
-        }
-    }
-
-    value = static_cast<uint32_t>(bits.to_ulong());
     return true;
 }
 
-bool LircPP::dataToKeyRC5(const std::vector<unsigned int>& data, uint32_t& value)
+bool LircPP::openTx()
 {
-    if (data.size() < 13) {
-        return false;
+    if (mTxFd != -1) {
+        return true;
     }
 
-    if (!checkTarget(data[0], 889)) {
-        return false;
+    // Reopened after a failed write; keep what was sent before it
+    if (!mTxPath.empty()) {
+        mTxFd = open(mTxPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        return mTxFd != -1;
     }
 
-    std::vector<bool> deflatedData;
-    for (unsigned int offset = 1; offset < data.size(); offset++)
-    {
-        bool pulse = (offset % 2);
-        if (checkTarget(data[offset], 889 * 3)) {
-            deflatedData.push_back(pulse);
-            deflatedData.push_back(pulse);
-            deflatedData.push_back(pulse);
-        } else if (checkTarget(data[offset], 889 * 2)) {
-            deflatedData.push_back(pulse);
-            deflatedData.push_back(pulse);
-        } else if (checkTarget(data[offset], 889)) {
-            deflatedData.push_back(pulse);
-        }
+    mTxFd = open("/dev/lirc-tx", O_WRONLY | O_CLOEXEC);
+    if (mTxFd == -1) {
+        return false;
     }
 
-    std::bitset<32> bits;
-    for (unsigned int i = 0, shift = 31; i < deflatedData.size(); i += 2, shift--) {
-        if (!deflatedData[i] && deflatedData[i + 1]) {
-            bits[shift--] = 1;
-        } else if (deflatedData[i] && !deflatedData[i + 1]) {
-            bits[shift--] = 0;
-        }
+    int mode = LIRC_MODE_PULSE;
+    if (ioctl(mTxFd, LIRC_SET_SEND_MODE, &mode)) {
+        closeTx();
+        return false;
     }
 
-    // We don't care about repeat bit
-    bits[29] = 0;
-
-    value = static_cast<uint32_t>(bits.to_ulong());
     return true;
 }
 
-bool LircPP::dataToKeyRC6(const std::vector<unsigned int>& data, uint32_t& value)
+void LircPP::closeTx()
 {
-    if (data.size() < 23 || data.size() > 77) {
-        return false;
+    if (mTxFd != -1) {
+        close(mTxFd);
+        mTxFd = -1;
+        mTxCarrier = 0;
     }
+}
 
-    // Header
-    if (!checkTarget(data[0], 444 * 6) || !checkTarget(data[1], 444 * 2)) {
+bool LircPP::dataToKey(bool pulse, unsigned int duration, IRCode& code)
+{
+    if (!mDecoder.push(pulse, duration, code)) {
         return false;
     }
 
-    // TODO
-
-    // Header
-    /*if (!checkTargetRC6(data[0], 920) || !checkTargetRC6(data[1], 830)) {
-        return false;
+    if (mVerbose) {
+        LOG(DEBUG, "Decoded %s%s frame", code.protocol->name, code.repeat ? " repeat" : "");
     }
-    
-    std::bitset<32> bits;
-    for (unsigned int i = 2, shift = 31; i < data.size() - 1; i += 2, shift--) {
-        unsigned int pulse = data[i];
-        unsigned int space = data[i + 1];
-        if (checkTargetRC6(space, 563)) {
-            bits[shift] = 0;
-        } else if (checkTargetRC6(space, 1687)) {
-            bits[shift] = 1;
-        } else {
-            return false;
+
+    return true;
+}
+
+bool LircPP::dataToKey(const std::vector<unsigned int>& data, IRCode& code)
+{
+    mDecoder.reset();
+
+    for (uint32_t i = 0; i < data.size(); i++) {
+        if (dataToKey(i % 2 == 0, data[i], code)) {
+            return true;
         }
     }
 
-    value = static_cast<uint32_t>(bits.to_ulong());
-    return true;*/
-
-    return false;
-}
\ No newline at end of file
+    return mDecoder.finish(code);
+}
@@ -1,32 +1,98 @@
 #ifndef LIRCPP_H
 #define LIRCPP_H
 
-#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "irdecoder.h"
+#include "irencoder.h"
 #include "keyname.h"
+#include "keytable.h"
+#include "mode2reader.h"
 
 class LircPP {
 public:
+    enum Event {
+        EVENT_PRESS,
+        EVENT_REPEAT,
+        EVENT_RELEASE,
+    };
+
+public:
+    // Loads keyspath into a table of its own; decodes without mapping
+    // to keys if it is empty
     LircPP(const std::string& keyspath);
+    LircPP(const KeyTable::RemotePtr& keys);
+    ~LircPP();
 
     void setVerbose(bool v);
 
-    bool receive(KeyName& key);
-    bool receiveRaw(uint32_t& value);
+    // Switch to another snapshot of the keys, from any thread. The
+    // current one stays alive for as long as anyone still holds it.
+    void setKeys(const KeyTable::RemotePtr& keys);
+    KeyTable::RemotePtr keys() const;
+
+    // Wait for the next key event. A key is held for as long as repeat
+    // frames (or repeats of its full frame) keep coming in, and released
+    // once they stop.
+    bool receive(KeyName& key, Event& event);
+    bool receiveRaw(IRCode& code, int timeoutMs = 5000);
     bool send(const KeyName& key);
+    bool send(const IRWaveform& waveform);
+
+    // Write what would be sent to a file instead of /dev/lirc-tx, as a mode2
+    // sample stream with a timeout after every waveform, so it can be read
+    // back through receiver().attach()
+    bool setTransmitFile(const std::string& path);
+
+    // Decode a complete frame of alternating pulses and spaces
+    bool dataToKey(const std::vector<unsigned int>& data, IRCode& code);
+
+    // Where samples come from; can be pointed at something other than the
+    // device, and captured
+    Mode2Reader& receiver() { return mRx; }
+
+    // Syscalls spent on the receive device for the last frame; safe to
+    // read from any thread
+    unsigned long frameSyscalls() const { return mFrameSyscalls.load(std::memory_order_relaxed); }
+
+    // Frames received that didn't decode
+    unsigned long decodeFailures() const { return mDecodeFailures; }
 
 private:
-    bool checkTarget(unsigned int value, unsigned int target);
+    bool openTx();
+    void closeTx();
+
+    typedef std::chrono::steady_clock Clock;
 
-    bool dataToKey(const std::vector<unsigned int>& data, uint32_t &value);
-    bool dataToKeyNEC(const std::vector<unsigned int>& data, uint32_t& value);
-    bool dataToKeyRC5(const std::vector<unsigned int>& data, uint32_t& value);
-    bool dataToKeyRC6(const std::vector<unsigned int>& data, uint32_t& value);
+    bool dataToKey(bool pulse, unsigned int duration, IRCode& code);
+    void hold(const KeyName& key, unsigned int frames);
 
     bool mVerbose;
-    std::unordered_map<KeyName, uint32_t> mData;
+
+    Mode2Reader mRx;
+    std::atomic<unsigned long> mFrameSyscalls;
+    unsigned long mDecodeFailures;
+
+    IRDecoder mDecoder;
+    unsigned int mFrameGap;
+    int mFrameTimeoutMs;
+    std::vector<unsigned int> mFrame;
+
+    int mTxFd;
+    unsigned int mTxCarrier;
+    std::string mTxPath;
+    std::vector<unsigned int> mTxSamples;
+    // Only accessed through std::atomic_load and std::atomic_store
+    KeyTable::RemotePtr mKeys;
+
+    KeyName mHeld;
+    unsigned int mHeldFrames;
+    Clock::time_point mHeldUntil;
+    KeyName mPending;
 };
 
 #endif //LIRCPP_H
\ No newline at end of file
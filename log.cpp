@@ -0,0 +1,254 @@
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <unistd.h>
+
+#include "eventloop.h"
+#include "log.h"
+
+namespace Log {
+
+static const size_t RING_SIZE = 256;
+static const size_t TEXT_SIZE = 240;
+
+// Bounded multi-producer queue, in the style of Vyukov's: a slot is free
+// for the producer at position pos while its sequence is pos, and holds a
+// message for the consumer once the producer has set it to pos + 1
+struct Slot {
+    std::atomic<size_t> sequence;
+    Level level;
+    size_t length;
+    char text[TEXT_SIZE];
+};
+
+static Slot sRing[RING_SIZE];
+static std::atomic<size_t> sEnqueue(0);
+static size_t sDequeue = 0;
+
+static std::atomic<int> sLevel(LEVEL_INFO);
+static std::atomic<uint64_t> sDropped(0);
+static Target sTarget = TARGET_STDERR;
+
+static std::thread sThread;
+static std::atomic<bool> sRunning(false);
+static EventNotifier* sWake = nullptr;
+
+// Messages published since the writer last looked; only the first one
+// after that wakes it up
+static std::atomic<unsigned int> sPending(0);
+
+static const char* const sLevelNames[] = {"error", "warning", "notice", "info", "debug", "traffic"};
+
+// syslog priorities: LOG_ERR, LOG_WARNING, LOG_NOTICE, LOG_INFO, LOG_DEBUG
+static const char sPriorities[] = {'3', '4', '5', '6', '7', '7'};
+
+static void output(const char* buf, size_t length)
+{
+    if (::write(STDERR_FILENO, buf, length) < 0) {
+        // Nowhere left to report it
+    }
+}
+
+static size_t prefix(Level level, char* out)
+{
+    if (sTarget != TARGET_JOURNAL) {
+        return 0;
+    }
+
+    out[0] = '<';
+    out[1] = sPriorities[level];
+    out[2] = '>';
+    return 3;
+}
+
+static size_t format(char* out, size_t size, const char* fmt, va_list args)
+{
+    int length = vsnprintf(out, size, fmt, args);
+    if (length < 0) {
+        return 0;
+    }
+
+    return (static_cast<size_t>(length) < size) ? length : size - 1;
+}
+
+static void init()
+{
+    for (size_t i = 0; i < RING_SIZE; i++) {
+        sRing[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+// Write out everything published so far; single consumer only
+static void drain()
+{
+    char buf[4096];
+    size_t used = 0;
+
+    while (true) {
+        Slot& slot = sRing[sDequeue % RING_SIZE];
+        if (slot.sequence.load(std::memory_order_acquire) != sDequeue + 1) {
+            break;
+        }
+
+        if (used + slot.length + 4 > sizeof(buf)) {
+            output(buf, used);
+            used = 0;
+        }
+
+        used += prefix(slot.level, buf + used);
+        memcpy(buf + used, slot.text, slot.length);
+        used += slot.length;
+        buf[used++] = '\n';
+
+        slot.sequence.store(sDequeue + RING_SIZE, std::memory_order_release);
+        sDequeue++;
+    }
+
+    if (used > 0) {
+        output(buf, used);
+    }
+}
+
+static void run()
+{
+    uint64_t reported = 0;
+    while (sRunning) {
+        // Only ever woken by a message or stop()
+        if (sWake->wait(-1)) {
+            sWake->clear();
+        }
+
+        // Anything published from here on wakes us again
+        sPending.store(0, std::memory_order_seq_cst);
+        drain();
+
+        uint64_t dropped = sDropped.load(std::memory_order_relaxed);
+        if (dropped != reported) {
+            char buf[64];
+            size_t length = prefix(LEVEL_WARNING, buf);
+            length += snprintf(buf + length, sizeof(buf) - length, "%llu log messages dropped\n",
+                               static_cast<unsigned long long>(dropped - reported));
+            output(buf, length);
+            reported = dropped;
+        }
+    }
+
+    drain();
+}
+
+void start(Target target)
+{
+    if (sRunning) {
+        return;
+    }
+
+    init();
+    sEnqueue = 0;
+    sDequeue = 0;
+    sTarget = target;
+    if (sWake == nullptr) {
+        // Never freed; a late message may still be notifying it
+        sWake = new EventNotifier();
+    }
+
+    sRunning = true;
+    sThread = std::thread(run);
+}
+
+void stop()
+{
+    if (!sRunning) {
+        return;
+    }
+
+    sRunning = false;
+    sWake->notify();
+    sThread.join();
+}
+
+void setLevel(Level level)
+{
+    sLevel.store(level, std::memory_order_relaxed);
+}
+
+Level levelFromString(const std::string& name, Level def)
+{
+    for (int i = 0; i <= LEVEL_TRAFFIC; i++) {
+        if (name == sLevelNames[i]) {
+            return static_cast<Level>(i);
+        }
+    }
+
+    return def;
+}
+
+Target targetFromString(const std::string& name, Target def)
+{
+    if (name == "stderr") {
+        return TARGET_STDERR;
+    } else if (name == "journal") {
+        return TARGET_JOURNAL;
+    }
+
+    return def;
+}
+
+bool enabled(Level level)
+{
+    return level <= sLevel.load(std::memory_order_relaxed);
+}
+
+void write(Level level, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+
+    if (!sRunning) {
+        char buf[TEXT_SIZE + 4];
+        size_t length = prefix(level, buf);
+        length += format(buf + length, TEXT_SIZE, fmt, args);
+        buf[length++] = '\n';
+        output(buf, length);
+        va_end(args);
+        return;
+    }
+
+    size_t pos = sEnqueue.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &sRing[pos % RING_SIZE];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (sEnqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // The writer hasn't caught up with the whole ring
+            sDropped.fetch_add(1, std::memory_order_relaxed);
+            va_end(args);
+            return;
+        } else {
+            pos = sEnqueue.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    slot->length = format(slot->text, TEXT_SIZE, fmt, args);
+    va_end(args);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    if (sPending.fetch_add(1, std::memory_order_seq_cst) == 0) {
+        sWake->notify();
+    }
+}
+
+uint64_t dropped()
+{
+    return sDropped.load(std::memory_order_relaxed);
+}
+
+}
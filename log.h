@@ -0,0 +1,63 @@
+#ifndef CECFORWARDER_LOG_H
+#define CECFORWARDER_LOG_H
+
+#include <cstdint>
+#include <string>
+
+// Asynchronous logging for the hot paths. A message is formatted straight
+// into a slot of a preallocated lock-free ring and written out by a
+// background thread, so the thread logging never blocks on stderr. When the
+// ring is full the message is dropped and counted.
+//
+// Messages below the runtime level are filtered before being formatted,
+// and those above CECFORWARDER_LOG_MAX_LEVEL are compiled out entirely.
+namespace Log {
+
+enum Level {
+    LEVEL_ERROR,
+    LEVEL_WARNING,
+    LEVEL_NOTICE,
+    LEVEL_INFO,
+    LEVEL_DEBUG,
+    // Every libCEC message, including the bus traffic
+    LEVEL_TRAFFIC,
+};
+
+enum Target {
+    TARGET_STDERR,
+    // stderr with syslog priority prefixes, for systemd's journal
+    TARGET_JOURNAL,
+};
+
+// Start the writer thread. Until then, and after stop(), messages are
+// written synchronously.
+void start(Target target = TARGET_STDERR);
+// Write out whatever is pending and stop the writer thread
+void stop();
+
+void setLevel(Level level);
+Level levelFromString(const std::string& name, Level def = LEVEL_INFO);
+Target targetFromString(const std::string& name, Target def = TARGET_STDERR);
+
+bool enabled(Level level);
+
+void write(Level level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+// Messages lost to a full ring
+uint64_t dropped();
+
+}
+
+#ifndef CECFORWARDER_LOG_MAX_LEVEL
+#define CECFORWARDER_LOG_MAX_LEVEL LEVEL_TRAFFIC
+#endif
+
+// LOG(INFO, "Key %s", key.name())
+#define LOG(level, ...) \
+    do { \
+        if (Log::LEVEL_##level <= Log::CECFORWARDER_LOG_MAX_LEVEL && Log::enabled(Log::LEVEL_##level)) { \
+            Log::write(Log::LEVEL_##level, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#endif // CECFORWARDER_LOG_H
@@ -1,105 +1,362 @@
+#include <algorithm>
 #include <cstdio>
-#include <fcntl.h>
-#include <iostream>
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <vector>
 #include <signal.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
 #include <p8-platform/os.h>
 #include <p8-platform/util/StringUtils.h>
 #include <p8-platform/threads/threads.h>
 
 #include "cecforwarder.h"
+#include "configfile.h"
+#include "configreloader.h"
+#include "eventloop.h"
 #include "irreader.h"
+#include "keytable.h"
+#include "latency.h"
+#include "log.h"
+#include "metricsserver.h"
+#include "simulation.h"
 
 using namespace P8PLATFORM;
 
 bool g_bHardExit(false);
 
-void sighandler(int iSignal)
+// Reconnect backoff, doubling from the first to the last delay
+static const unsigned int RECONNECT_MIN_MS = 1000;
+static const unsigned int RECONNECT_MAX_MS = 30000;
+
+// How often the wakeup rate is reported in verbose mode
+static const unsigned int STATS_INTERVAL_MS = 60000;
+
+static const std::string CONFIG_DIR = "/etc/cec-forwarder/";
+static const std::string KEYS_DIR = CONFIG_DIR + "keys/";
+
+// Everything the config and key files set that can change while running
+struct Setup {
+    KeyTable::Ptr keyTable;
+    KeyTable::RemotePtr irKeys;
+    // nullptr when only recording
+    CecForwarder::BindingsPtr bindings;
+    int repeatDelay, repeatRate;
+    size_t txQueue;
+    IRTransmitter::Policy txPolicy;
+    Log::Level logLevel;
+};
+
+// Load the keys and bindings config refers to; false if it isn't usable
+static bool loadSetup(const ConfigFile& config, bool recordOnly, Setup& setup)
+{
+    const ConfigFile::Section* mainSection = config.getSection("Main");
+    if (mainSection == nullptr || !mainSection->hasKey("keyname")) {
+        LOG(ERROR, "Config: Required Main.keyname parameter missing");
+        return false;
+    }
+
+    // Both remotes share one table; irname is optional when only recording
+    std::vector<std::string> keyFiles;
+    if (!recordOnly) {
+        keyFiles.push_back(KEYS_DIR + mainSection->value("keyname"));
+    }
+
+    if (mainSection->hasKey("irname")) {
+        keyFiles.push_back(KEYS_DIR + mainSection->value("irname"));
+    }
+
+    setup.keyTable = KeyTable::load(keyFiles);
+    if (setup.keyTable == nullptr) {
+        LOG(ERROR, "Failed loading keys");
+        return false;
+    }
+
+    setup.irKeys = KeyTable::remote(setup.keyTable, KEYS_DIR + mainSection->value("irname"));
+    setup.repeatDelay = mainSection->intValue("repeatdelay");
+    setup.repeatRate = mainSection->intValue("repeatrate");
+    setup.txQueue = mainSection->intValue("txqueue");
+    setup.txPolicy = IRTransmitter::policyFromString(mainSection->value("txpolicy"));
+    setup.logLevel = Log::levelFromString(mainSection->value("loglevel"));
+
+    if (recordOnly) {
+        return true;
+    }
+
+    std::shared_ptr<CecForwarder::Bindings> bindings(
+        new CecForwarder::Bindings(KeyTable::remote(setup.keyTable, KEYS_DIR + mainSection->value("keyname"))));
+
+    // A keymap compiled together with this config already has the table
+    const ConfigFile::Section* keySection = config.getSection("Keys");
+    if (!bindings->loadCompiledKeys(config.path()) && keySection != nullptr) {
+        for (auto it = keySection->begin(); it != keySection->end(); it++) {
+            bindings->addKey(std::atoi(it->key), it->value);
+        }
+    }
+
+    const ConfigFile::Section* actionSection = config.getSection("Actions");
+    if (actionSection != nullptr) {
+        for (auto it = actionSection->begin(); it != actionSection->end(); it++) {
+            bindings->addAction(it->key, it->value);
+        }
+    }
+
+    setup.bindings = bindings;
+    return true;
+}
+
+// Dump latencies on SIGUSR1, stop the loop on SIGINT or SIGTERM
+static void watchSignals(EventLoop& loop, int signalFd)
 {
-    std::cerr << "signal caught: " << iSignal << " - exiting\n";
-    g_bHardExit = true;
+    loop.add(signalFd, [&loop, signalFd] {
+        signalfd_siginfo info;
+        if (read(signalFd, &info, sizeof(info)) != sizeof(info)) {
+            return;
+        }
+
+        if (info.ssi_signo == SIGUSR1) {
+            // One message per line, so the journal keeps the table intact
+            std::ostringstream out;
+            Latency::dump(out);
+            std::istringstream lines(out.str());
+            std::string line;
+            while (std::getline(lines, line)) {
+                LOG(NOTICE, "%s", line.c_str());
+            }
+        } else {
+            LOG(NOTICE, "signal caught: %u - exiting", info.ssi_signo);
+            g_bHardExit = true;
+            loop.stop();
+        }
+    });
 }
 
 int main (int argc, char *argv[])
 {
-    if (signal(SIGINT, sighandler) == SIG_ERR) {
-        std::cerr << "can't register sighandler\n";
+    // Blocked before any thread is started, so that every thread inherits
+    // the mask and the signals are only ever seen through the signalfd
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    int signalFd = -1;
+    if (pthread_sigmask(SIG_BLOCK, &signals, nullptr) != 0 ||
+            (signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC)) == -1) {
+        LOG(ERROR, "can't register signal handling");
         return -1;
     }
 
-    bool argVerbose = false, argRecord = false;
+    bool argVerbose = false, argRecord = false, argSimulate = false;
+    std::string argCapture;
     for (int i = 1; i < argc; i++) {
         std::string a = std::string(argv[i]);
         if (a == "-v" || a == "--verbose") {
             argVerbose = true;
         } else if (a == "-r" || a == "--record") {
             argRecord = true;
+        } else if (a == "-s" || a == "--simulate") {
+            argSimulate = true;
+        } else if ((a == "-c" || a == "--capture") && i + 1 < argc) {
+            argCapture = argv[++i];
         }
     }
 
-    HueConfig config("/etc/cec-forwarder/cec-forwarder.config");
+    const std::string configPath = CONFIG_DIR + "cec-forwarder.config";
+    ConfigFile config(configPath);
     if (!config.parse()) {
-        std::cerr << "Failed parsing config\n";
+        LOG(ERROR, "Failed parsing %s", configPath.c_str());
         return -1;
     }
 
     if (!config.contains("Main", "keyname")) {
-        std::cerr << "Config: Required Main.keyname parameter missing\n";
+        LOG(ERROR, "Config: Required Main.keyname parameter missing");
         return -1;
     }
 
-    HueConfigSection* mainSection = config.getSection("Main");
+    const ConfigFile::Section* mainSection = config.getSection("Main");
+    const std::string logtarget = mainSection->value("logtarget");
+    const std::string metricssocket = mainSection->value("metricssocket");
 
     std::string cecname = "CECForwarder";
     if (mainSection->hasKey("cecname")) {
         cecname = mainSection->value("cecname");
     }
 
-    IRReader irReader("/etc/cec-forwarder", mainSection->value("irname"), argRecord);
+    // Verbose shows everything, down to the bus traffic
+    Log::setLevel(argVerbose ? Log::LEVEL_TRAFFIC : Log::levelFromString(mainSection->value("loglevel")));
+    Log::start(Log::targetFromString(logtarget));
+
+    Setup setup;
+    if (!loadSetup(config, argRecord, setup)) {
+        return -1;
+    }
+
+    IRReader irReader(setup.irKeys, argRecord);
+    if (!argCapture.empty() && !irReader.setCapture(argCapture)) {
+        return -1;
+    }
+
+    // The reader gives up waiting for the device after 5 seconds
+    const int READER_STOP_MS = 6000;
+
     if (argRecord) {
         irReader.setVerbose(true);
         irReader.CreateThread(false);
-        
-        while (!g_bHardExit) {
-            CEvent::Sleep(1);
-        }
+
+        EventLoop loop;
+        watchSignals(loop, signalFd);
+        loop.run();
 
         irReader.cancel();
+        irReader.StopThread(READER_STOP_MS);
 
-        return 0;   
+        return 0;
     }
 
-    CecForwarder forwarder("/etc/cec-forwarder", mainSection->value("keyname"), cecname, argVerbose);
-    forwarder.setRepeat(mainSection->intValue("repeatdelay"), mainSection->intValue("repeatrate"));
+    // Simulated presses for the keys in the map are fed in instead of a
+    // real adapter, and IR goes to a file
+    SimulatedCecAdapter* simulator = nullptr;
+    if (argSimulate) {
+        simulator = new SimulatedCecAdapter(Simulation::settings(config));
+    }
 
-    HueConfigSection* keySection = config.getSection("Keys");
-    if (keySection != nullptr) {
-        for (auto it = keySection->begin(); it != keySection->end(); it++) {
-            forwarder.addKey(std::atoi(it->first.c_str()), it->second);
-        }
+    CecForwarder forwarder(setup.bindings, cecname, simulator);
+    forwarder.setRepeat(setup.repeatDelay, setup.repeatRate);
+    forwarder.setTransmitQueue(setup.txQueue, setup.txPolicy);
+
+    if (argSimulate) {
+        int ret = Simulation::run(forwarder, *simulator, config);
+        close(signalFd);
+        Log::stop();
+        return ret;
     }
 
     irReader.setVerbose(argVerbose);
     irReader.addCallback(&forwarder);
     irReader.CreateThread(false);
 
-    while (!g_bHardExit) {
-        if (!forwarder.ensureOpen()) {
-            CEvent::Sleep(1000);
-            continue;
+    EventLoop loop;
+    watchSignals(loop, signalFd);
+    forwarder.attach(loop);
+
+    // Only wake up to (re)open the adapter: right away, when libCEC
+    // reports the connection lost, and then with backoff until it opens
+    EventTimer reconnectTimer;
+    unsigned int reconnectDelay = RECONNECT_MIN_MS;
+    auto reconnect = [&] {
+        if (forwarder.ensureOpen()) {
+            reconnectDelay = RECONNECT_MIN_MS;
+            return;
+        }
+
+        reconnectTimer.arm(reconnectDelay);
+        reconnectDelay = std::min(reconnectDelay * 2, RECONNECT_MAX_MS);
+    };
+
+    loop.add(reconnectTimer.fd(), [&] {
+        reconnectTimer.read();
+        reconnect();
+    });
+
+    loop.add(forwarder.connectionLost().fd(), [&] {
+        forwarder.connectionLost().clear();
+        reconnectTimer.disarm();
+        reconnectDelay = RECONNECT_MIN_MS;
+        reconnect();
+    });
+
+    EventTimer statsTimer;
+    unsigned long lastWakeups = 0;
+    if (argVerbose) {
+        statsTimer.arm(STATS_INTERVAL_MS, STATS_INTERVAL_MS);
+        loop.add(statsTimer.fd(), [&] {
+            statsTimer.read();
+            unsigned long wakeups = loop.wakeups() - lastWakeups;
+            lastWakeups = loop.wakeups();
+            LOG(INFO, "Main loop: %lu wakeups in %us, %g/s", wakeups, STATS_INTERVAL_MS / 1000,
+                static_cast<double>(wakeups) * 1000 / STATS_INTERVAL_MS);
+
+            IRReader::Stats rx = irReader.stats();
+            LOG(INFO, "IR keys: %llu dispatched, max %zu pending, %llu dropped, %llu releases dropped, "
+                "%lu syscalls for the last frame",
+                static_cast<unsigned long long>(rx.dispatched), rx.maxDepth, static_cast<unsigned long long>(rx.overflows),
+                static_cast<unsigned long long>(rx.releaseOverflows), rx.frameSyscalls);
+        });
+    }
+
+    MetricsServer metrics(loop);
+    if (mainSection->hasKey("metricssocket") && metrics.listen(mainSection->value("metricssocket"))) {
+        metrics.addSource([&](std::ostream& out) {
+            IRTransmitter::Stats stats = forwarder.transmitStats();
+            IRReader::Stats rx = irReader.stats();
+            out << "# TYPE cecforwarder_tx_queue_depth gauge\n"
+                << "cecforwarder_tx_queue_depth " << stats.depth << "\n"
+                << "# TYPE cecforwarder_tx_queue_max_depth gauge\n"
+                << "cecforwarder_tx_queue_max_depth " << stats.maxDepth << "\n"
+                << "# TYPE cecforwarder_tx_queue_dropped_total counter\n"
+                << "cecforwarder_tx_queue_dropped_total " << stats.dropped << "\n"
+                << "# TYPE cecforwarder_tx_queue_coalesced_total counter\n"
+                << "cecforwarder_tx_queue_coalesced_total " << stats.coalesced << "\n"
+                << "# TYPE cecforwarder_rx_ring_max_depth gauge\n"
+                << "cecforwarder_rx_ring_max_depth " << rx.maxDepth << "\n"
+                << "# TYPE cecforwarder_rx_ring_overflows_total counter\n"
+                << "cecforwarder_rx_ring_overflows_total " << rx.overflows << "\n"
+                << "# TYPE cecforwarder_rx_ring_release_overflows_total counter\n"
+                << "cecforwarder_rx_ring_release_overflows_total " << rx.releaseOverflows << "\n"
+                << "# TYPE cecforwarder_rx_frame_syscalls gauge\n"
+                << "cecforwarder_rx_frame_syscalls " << rx.frameSyscalls << "\n"
+                << "# TYPE cecforwarder_main_loop_wakeups_total counter\n"
+                << "cecforwarder_main_loop_wakeups_total " << loop.wakeups() << "\n";
+        });
+    }
+
+    // Parsed and loaded aside, then swapped in whole; the adapter stays
+    // open, and keys already pressed finish with what they started with
+    ConfigReloader reloader([&] {
+        ConfigFile changed(configPath);
+        Setup next;
+        if (!changed.parse() || !loadSetup(changed, false, next)) {
+            LOG(ERROR, "Failed reloading %s, keeping the running config", configPath.c_str());
+            return;
+        }
+
+        forwarder.setBindings(next.bindings);
+        irReader.setKeys(next.irKeys);
+        forwarder.setRepeat(next.repeatDelay, next.repeatRate);
+        forwarder.setTransmitQueue(next.txQueue, next.txPolicy);
+        if (!argVerbose) {
+            Log::setLevel(next.logLevel);
         }
 
-        CEvent::Sleep(1);
+        const ConfigFile::Section* nextMain = changed.getSection("Main");
+        if (cecname != nextMain->value("cecname", "CECForwarder") || logtarget != nextMain->value("logtarget") ||
+                metricssocket != nextMain->value("metricssocket")) {
+            LOG(NOTICE, "Changes to cecname, logtarget or metricssocket take effect on restart");
+        }
+
+        LOG(NOTICE, "Reloaded %s", configPath.c_str());
+    });
+
+    if (reloader.watch(CONFIG_DIR) && reloader.watch(KEYS_DIR)) {
+        reloader.attach(loop);
+        reloader.CreateThread(false);
     }
 
-    std::cerr << "All done\n";
+    reconnect();
+    loop.run();
+
+    LOG(INFO, "All done");
 
+    reloader.cancel();
+    reloader.StopThread();
     forwarder.close();
     irReader.cancel();
+    irReader.StopThread(READER_STOP_MS);
+    close(signalFd);
+    Log::stop();
 
     return (g_bHardExit) ? -1 : 0;
 }
@@ -0,0 +1,142 @@
+#include <atomic>
+
+#include "latency.h"
+#include "log.h"
+#include "metrics.h"
+
+namespace Metrics {
+
+typedef std::atomic<uint64_t> Counter;
+
+static const size_t MAX_PROTOCOLS = 16;
+
+// Zero-initialised, like the latency histograms
+static Counter sIrFrames[MAX_PROTOCOLS];
+static Counter sIrRepeatFrames[MAX_PROTOCOLS];
+static Counter sIrDecodeFailures;
+static Counter sKeysTransmitted;
+static Counter sTxErrors;
+static Counter sCecCommands[256];
+static Counter sAdapterOpens;
+static Counter sAdapterOpenFailures;
+static Counter sRepeatsSuppressed;
+static Counter sRepeatsGenerated;
+
+static inline void increment(Counter& counter)
+{
+    counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+static inline uint64_t get(const Counter& counter)
+{
+    return counter.load(std::memory_order_relaxed);
+}
+
+void irFrame(const IRCode& code)
+{
+    for (size_t i = 0; i < IRProtocol::sProtocolCount && i < MAX_PROTOCOLS; i++) {
+        if (IRProtocol::sProtocols[i] == code.protocol) {
+            increment(code.repeat ? sIrRepeatFrames[i] : sIrFrames[i]);
+            return;
+        }
+    }
+}
+
+void irDecodeFailure()
+{
+    increment(sIrDecodeFailures);
+}
+
+void keyTransmitted()
+{
+    increment(sKeysTransmitted);
+}
+
+void txError()
+{
+    increment(sTxErrors);
+}
+
+void cecCommand(uint8_t opcode)
+{
+    increment(sCecCommands[opcode]);
+}
+
+void adapterOpened()
+{
+    increment(sAdapterOpens);
+}
+
+void adapterOpenFailed()
+{
+    increment(sAdapterOpenFailures);
+}
+
+void repeatSuppressed()
+{
+    increment(sRepeatsSuppressed);
+}
+
+void repeatGenerated()
+{
+    increment(sRepeatsGenerated);
+}
+
+static void header(std::ostream& out, const char* name, const char* type, const char* help)
+{
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " " << type << "\n";
+}
+
+static void counter(std::ostream& out, const char* name, const char* help, const Counter& value)
+{
+    header(out, name, "counter", help);
+    out << name << " " << get(value) << "\n";
+}
+
+void write(std::ostream& out)
+{
+    header(out, "cecforwarder_ir_frames_total", "counter", "IR frames decoded, by protocol and kind");
+    for (size_t i = 0; i < IRProtocol::sProtocolCount && i < MAX_PROTOCOLS; i++) {
+        const char* name = IRProtocol::sProtocols[i]->name;
+        out << "cecforwarder_ir_frames_total{protocol=\"" << name << "\",kind=\"full\"} " << get(sIrFrames[i]) << "\n";
+        if (IRProtocol::sProtocols[i]->repeatSpace > 0) {
+            out << "cecforwarder_ir_frames_total{protocol=\"" << name << "\",kind=\"repeat\"} " << get(sIrRepeatFrames[i]) << "\n";
+        }
+    }
+
+    counter(out, "cecforwarder_ir_decode_failures_total", "IR frames that matched no protocol", sIrDecodeFailures);
+    counter(out, "cecforwarder_ir_keys_transmitted_total", "IR keys written to the transmitter", sKeysTransmitted);
+    counter(out, "cecforwarder_ir_tx_errors_total", "IR keys that failed to send", sTxErrors);
+
+    header(out, "cecforwarder_cec_commands_total", "counter", "CEC commands received, by opcode");
+    for (unsigned int i = 0; i < 256; i++) {
+        uint64_t value = get(sCecCommands[i]);
+        if (value > 0) {
+            static const char digits[] = "0123456789abcdef";
+            out << "cecforwarder_cec_commands_total{opcode=\"0x" << digits[i >> 4] << digits[i & 0xF] << "\"} " << value << "\n";
+        }
+    }
+
+    counter(out, "cecforwarder_cec_adapter_opens_total", "Successful CEC adapter (re)connects", sAdapterOpens);
+    counter(out, "cecforwarder_cec_adapter_open_failures_total", "Failed CEC adapter connection attempts", sAdapterOpenFailures);
+    counter(out, "cecforwarder_repeats_suppressed_total", "CEC presses resent for a key that was already held", sRepeatsSuppressed);
+    counter(out, "cecforwarder_repeats_generated_total", "IR repeats sent for held CEC keys", sRepeatsGenerated);
+
+    header(out, "cecforwarder_log_dropped_total", "counter", "Log messages lost to a full log ring");
+    out << "cecforwarder_log_dropped_total " << Log::dropped() << "\n";
+
+    header(out, "cecforwarder_latency_seconds", "summary", "Time spent in each stage of forwarding a key");
+    for (int i = 0; i < Latency::STAGE_COUNT; i++) {
+        Latency::Stage stage = static_cast<Latency::Stage>(i);
+        const LatencyHistogram& h = Latency::histogram(stage);
+        const char* name = Latency::stageName(stage);
+        out << "cecforwarder_latency_seconds{stage=\"" << name << "\",quantile=\"0.5\"} " << h.percentile(0.5) / 1e9 << "\n";
+        out << "cecforwarder_latency_seconds{stage=\"" << name << "\",quantile=\"0.99\"} " << h.percentile(0.99) / 1e9 << "\n";
+        out << "cecforwarder_latency_seconds{stage=\"" << name << "\",quantile=\"1\"} " << h.max() / 1e9 << "\n";
+        out << "cecforwarder_latency_seconds_sum{stage=\"" << name << "\"} " << h.sum() / 1e9 << "\n";
+        out << "cecforwarder_latency_seconds_count{stage=\"" << name << "\"} " << h.count() << "\n";
+    }
+}
+
+}
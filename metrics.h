@@ -0,0 +1,36 @@
+#ifndef CECFORWARDER_METRICS_H
+#define CECFORWARDER_METRICS_H
+
+#include <cstdint>
+#include <ostream>
+
+#include "irprotocol.h"
+
+// Process-wide counters. Every update is a single relaxed atomic
+// increment; formatting only happens when they are written out.
+namespace Metrics {
+
+// A frame came in and decoded, or didn't
+void irFrame(const IRCode& code);
+void irDecodeFailure();
+
+void keyTransmitted();
+void txError();
+
+void cecCommand(uint8_t opcode);
+
+void adapterOpened();
+void adapterOpenFailed();
+
+// A resent CEC press that only extended a held key, and a repeat that
+// was generated for one
+void repeatSuppressed();
+void repeatGenerated();
+
+// All of the above and the latency histograms, in the Prometheus text
+// exposition format
+void write(std::ostream& out);
+
+}
+
+#endif // CECFORWARDER_METRICS_H
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "log.h"
+#include "metrics.h"
+#include "metricsserver.h"
+
+MetricsServer::MetricsServer(EventLoop& loop)
+    : mLoop(loop)
+    , mFd(-1)
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    while (!mClients.empty()) {
+        drop(mClients.front());
+    }
+
+    if (mFd != -1) {
+        mLoop.remove(mFd);
+        close(mFd);
+        unlink(mPath.c_str());
+    }
+}
+
+bool MetricsServer::listen(const std::string& path)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        LOG(ERROR, "Metrics socket path too long: %s", path.c_str());
+        return false;
+    }
+
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    mFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (mFd == -1) {
+        LOG(ERROR, "Failed creating metrics socket: %s", strerror(errno));
+        return false;
+    }
+
+    // A socket left behind by a previous run would make bind fail
+    unlink(path.c_str());
+    if (bind(mFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 || ::listen(mFd, 4) == -1) {
+        LOG(ERROR, "Failed listening on %s: %s", path.c_str(), strerror(errno));
+        close(mFd);
+        mFd = -1;
+        return false;
+    }
+
+    mPath = path;
+    return mLoop.add(mFd, [this] { accept(); });
+}
+
+void MetricsServer::addSource(const Source& source)
+{
+    mSources.push_back(source);
+}
+
+void MetricsServer::accept()
+{
+    int fd = accept4(mFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd == -1) {
+        return;
+    }
+
+    // Don't let idle clients pile up
+    if (mClients.size() >= MAX_CLIENTS) {
+        drop(mClients.front());
+    }
+
+    mClients.push_back(fd);
+    mLoop.add(fd, [this, fd] { respond(fd); });
+}
+
+void MetricsServer::respond(int fd)
+{
+    char request[1024];
+    ssize_t size = read(fd, request, sizeof(request));
+    if (size <= 0) {
+        if (size == 0 || errno != EAGAIN) {
+            drop(fd);
+        }
+
+        return;
+    }
+
+    std::ostringstream body;
+    Metrics::write(body);
+    for (auto& source: mSources) {
+        source(body);
+    }
+
+    // Speak just enough HTTP for curl and Prometheus; anything else gets
+    // the bare text
+    std::string response;
+    if (size >= 4 && memcmp(request, "GET ", 4) == 0) {
+        std::string text = body.str();
+        response = "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: " + std::to_string(text.size()) + "\r\n"
+            "Connection: close\r\n\r\n" + text;
+    } else {
+        response = body.str();
+    }
+
+    // The response fits in the socket buffer of any client that is
+    // actually reading; give up on one that isn't
+    const char* data = response.data();
+    size_t left = response.size();
+    while (left > 0) {
+        ssize_t written = send(fd, data, left, MSG_NOSIGNAL);
+        if (written <= 0) {
+            break;
+        }
+
+        data += written;
+        left -= written;
+    }
+
+    drop(fd);
+}
+
+void MetricsServer::drop(int fd)
+{
+    mLoop.remove(fd);
+    close(fd);
+    mClients.erase(std::remove(mClients.begin(), mClients.end(), fd), mClients.end());
+}
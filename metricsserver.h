@@ -0,0 +1,43 @@
+#ifndef CECFORWARDER_METRICSSERVER_H
+#define CECFORWARDER_METRICSSERVER_H
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "eventloop.h"
+
+// Serves Metrics::write() on a local UNIX socket, for
+// `curl --unix-socket <path> http://localhost/metrics` or anything else
+// that sends a line and reads until the connection closes. Runs on an
+// event loop; nothing is formatted until a client asks.
+class MetricsServer {
+public:
+    typedef std::function<void(std::ostream&)> Source;
+
+public:
+    MetricsServer(EventLoop& loop);
+    ~MetricsServer();
+
+    bool listen(const std::string& path);
+
+    // Extra metrics that live elsewhere, written after the global ones
+    void addSource(const Source& source);
+
+private:
+    void accept();
+    void respond(int fd);
+    void drop(int fd);
+
+    // Clients that connected but haven't sent their request yet
+    static const size_t MAX_CLIENTS = 8;
+
+    EventLoop& mLoop;
+    std::string mPath;
+    int mFd;
+    std::vector<int> mClients;
+    std::vector<Source> mSources;
+};
+
+#endif // CECFORWARDER_METRICSSERVER_H
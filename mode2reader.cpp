@@ -0,0 +1,208 @@
+#include <algorithm>
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <linux/lirc.h>
+
+#include "capture.h"
+#include "latency.h"
+#include "log.h"
+#include "mode2reader.h"
+
+Mode2Reader::Mode2Reader(const std::string& path)
+    : mPath(path)
+    , mFd(-1)
+    , mTimeout(0)
+    , mAttached(false)
+    , mEnd(false)
+    , mCapture(nullptr)
+    , mPos(0)
+    , mLen(0)
+    , mPartial(0)
+    , mSyscalls(0)
+{
+}
+
+Mode2Reader::~Mode2Reader()
+{
+    close();
+}
+
+bool Mode2Reader::open()
+{
+    if (mFd != -1 || mAttached) {
+        return mFd != -1;
+    }
+
+    mSyscalls++;
+    mFd = ::open(mPath.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+    if (mFd == -1) {
+        return false;
+    }
+
+    int mode = LIRC_MODE_MODE2;
+    mSyscalls++;
+    if (ioctl(mFd, LIRC_SET_REC_MODE, &mode)) {
+        LOG(ERROR, "Failed setting mode2 receive mode on %s", mPath.c_str());
+        close();
+        return false;
+    }
+
+    if (mTimeout > 0) {
+        applyTimeout();
+    }
+
+    return true;
+}
+
+bool Mode2Reader::attach(int fd)
+{
+    close();
+
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        LOG(ERROR, "Failed attaching fd %d", fd);
+        return false;
+    }
+
+    mFd = fd;
+    mAttached = true;
+    mEnd = false;
+    return true;
+}
+
+void Mode2Reader::setTimeout(unsigned int us)
+{
+    mTimeout = us;
+    if (mFd != -1 && !mAttached) {
+        applyTimeout();
+    }
+}
+
+void Mode2Reader::applyTimeout()
+{
+    // Not every driver supports timeouts; the reader copes without them
+    uint32_t timeout = mTimeout, min = 0, max = 0;
+    mSyscalls += 2;
+    if (ioctl(mFd, LIRC_GET_MIN_TIMEOUT, &min) == 0 && ioctl(mFd, LIRC_GET_MAX_TIMEOUT, &max) == 0) {
+        timeout = std::min(std::max(timeout, min), max);
+    }
+
+    mSyscalls++;
+    ioctl(mFd, LIRC_SET_REC_TIMEOUT, &timeout);
+}
+
+void Mode2Reader::close()
+{
+    if (mFd != -1) {
+        mSyscalls++;
+        ::close(mFd);
+        mFd = -1;
+    }
+
+    mAttached = mEnd = false;
+    mPos = mLen = mPartial = 0;
+}
+
+bool Mode2Reader::next(unsigned& sample, int timeoutMs)
+{
+    if (mPos == mLen && !fill(timeoutMs)) {
+        return false;
+    }
+
+    sample = mBuf[mPos++];
+    return true;
+}
+
+bool Mode2Reader::fill(int timeoutMs)
+{
+    if (!open()) {
+        return false;
+    }
+
+    // Move a split sample to the front for the rest of it to be read in
+    char* buf = reinterpret_cast<char*>(mBuf.data());
+    memmove(buf, buf + mLen * sizeof(unsigned), mPartial);
+    mPos = mLen = 0;
+
+    // The descriptor is non-blocking, so try the read first and only poll
+    // when nothing is pending. A frame that has already arrived costs a
+    // single syscall.
+    bool polled = false;
+    while (true) {
+        mSyscalls++;
+        ssize_t ret = read(mFd, buf + mPartial, mBuf.size() * sizeof(unsigned) - mPartial);
+        if (ret > 0 && (mAttached || ret % sizeof(unsigned) == 0)) {
+            size_t bytes = mPartial + ret;
+            mLen = bytes / sizeof(unsigned);
+            mPartial = bytes % sizeof(unsigned);
+            if (mLen == 0) {
+                continue;
+            }
+
+            if (mCapture != nullptr) {
+                uint64_t now = Latency::now() / 1000;
+                for (size_t i = 0; i < mLen; i++) {
+                    mCapture->write(mBuf[i], now);
+                }
+            }
+
+            return true;
+        }
+
+        if (ret == 0 && mAttached) {
+            mEnd = true;
+            return false;
+        }
+
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (ret < 0 && errno == EAGAIN && !polled) {
+            struct pollfd fds[1];
+            fds[0].fd = mFd;
+            fds[0].events = POLLIN;
+
+            mSyscalls++;
+            int p = poll(fds, 1, timeoutMs);
+            if (p < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (p != 1) {
+                return false;
+            }
+
+            // A pipe hangs up once the writer is gone, with data possibly
+            // still pending; the read tells
+            if ((fds[0].revents & (POLLERR | POLLNVAL)) || ((fds[0].revents & POLLHUP) && !mAttached)) {
+                break;
+            }
+
+            polled = true;
+            continue;
+        }
+
+        if (ret < 0 && errno == EAGAIN) {
+            return false;
+        }
+
+        break;
+    }
+
+    if (mAttached) {
+        LOG(ERROR, "Error reading attached stream");
+        mEnd = true;
+        return false;
+    }
+
+    // Short read, EOF or device error; start over on the next call
+    LOG(ERROR, "Error reading %s, reopening", mPath.c_str());
+    close();
+    return false;
+}
@@ -0,0 +1,66 @@
+#ifndef CECFORWARDER_MODE2READER_H
+#define CECFORWARDER_MODE2READER_H
+
+#include <array>
+#include <string>
+
+class CaptureWriter;
+
+// Buffered reader for a LIRC mode2 receive device. The descriptor is kept
+// open between frames and samples left over from one read are handed out
+// before the device is touched again.
+//
+// Instead of the device, any descriptor carrying a raw mode2 sample stream
+// (a file, pipe or socket) can be attached; it is read until end of file.
+class Mode2Reader {
+public:
+    Mode2Reader(const std::string& path = "/dev/lirc-rx");
+    ~Mode2Reader();
+
+    bool open();
+    void close();
+    bool isOpen() const { return mFd != -1; }
+
+    // Read from fd, which this takes ownership of, rather than the device
+    bool attach(int fd);
+
+    // An attached stream has been read to the end
+    bool atEnd() const { return mEnd; }
+
+    // Record every sample read, with the time it was read, to capture
+    // (nullptr to stop). The writer must outlive the reader.
+    void setCapture(CaptureWriter* capture) { mCapture = capture; }
+
+    // Idle time after which the receiver reports a timeout, in
+    // microseconds. Applied (clamped to what the driver supports) every
+    // time the device is opened.
+    void setTimeout(unsigned int us);
+
+    // Fetch the next raw mode2 sample, waiting at most timeoutMs for the
+    // device. Returns false on timeout or error; after an error the device
+    // is reopened on the next call.
+    bool next(unsigned& sample, int timeoutMs);
+
+    // Number of syscalls issued against the device since it was created
+    unsigned long syscalls() const { return mSyscalls; }
+
+private:
+    bool fill(int timeoutMs);
+    void applyTimeout();
+
+    std::string mPath;
+    int mFd;
+    unsigned int mTimeout;
+    bool mAttached, mEnd;
+    CaptureWriter* mCapture;
+
+    std::array<unsigned, 512> mBuf;
+    size_t mPos, mLen;
+
+    // Bytes of a sample split across reads of an attached stream
+    size_t mPartial;
+
+    unsigned long mSyscalls;
+};
+
+#endif // CECFORWARDER_MODE2READER_H
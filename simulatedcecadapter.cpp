@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "simulatedcecadapter.h"
+
+using namespace CEC;
+
+// A TV resends User Control Pressed this often while a key is held
+static const unsigned int RESEND_MS = 400;
+
+SimulatedCecAdapter::SimulatedCecAdapter(const Settings& settings)
+    : mSettings(settings)
+    , mCallbacks(nullptr)
+    , mCallbackParam(nullptr)
+    , mRunning(false)
+    , mCommands(0)
+    , mActiveSource(CECDEVICE_TV)
+{
+    if (mSettings.rate == 0) {
+        mSettings.rate = 1000;
+    }
+}
+
+SimulatedCecAdapter::~SimulatedCecAdapter()
+{
+    mRunning = false;
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+SimulatedCecAdapter::Pattern SimulatedCecAdapter::patternFromString(const std::string& name, Pattern def)
+{
+    if (name == "burst") {
+        return PATTERN_BURST;
+    } else if (name == "hold") {
+        return PATTERN_HOLD;
+    } else if (name == "mixed") {
+        return PATTERN_MIXED;
+    }
+
+    return def;
+}
+
+bool SimulatedCecAdapter::initialise(libcec_configuration& config)
+{
+    mCallbacks = config.callbacks;
+    mCallbackParam = config.callbackParam;
+    return mCallbacks != nullptr && !mSettings.keys.empty();
+}
+
+bool SimulatedCecAdapter::open()
+{
+    // Only the first open starts playing; a reconnect carries on
+    if (!mThread.joinable()) {
+        mRunning = true;
+        mThread = std::thread(&SimulatedCecAdapter::run, this);
+    }
+
+    return true;
+}
+
+void SimulatedCecAdapter::close()
+{
+    mRunning = false;
+    if (mThread.joinable() && mThread.get_id() != std::this_thread::get_id()) {
+        mThread.join();
+    }
+}
+
+cec_logical_address SimulatedCecAdapter::getActiveSource()
+{
+    return static_cast<cec_logical_address>(mActiveSource.load());
+}
+
+uint16_t SimulatedCecAdapter::getDevicePhysicalAddress(cec_logical_address address)
+{
+    // Every device on its own TV input
+    return static_cast<uint16_t>((address & 0xF) << 12);
+}
+
+bool SimulatedCecAdapter::powerOnDevices(cec_logical_address address)
+{
+    record(Sent::SENT_POWER_ON, address);
+    return true;
+}
+
+bool SimulatedCecAdapter::standbyDevices(cec_logical_address address)
+{
+    record(Sent::SENT_STANDBY, address);
+    return true;
+}
+
+bool SimulatedCecAdapter::setActiveSource()
+{
+    // We are the playback device the TV sends its keys to
+    mActiveSource = CECDEVICE_PLAYBACKDEVICE1;
+    record(Sent::SENT_ACTIVE_SOURCE, CECDEVICE_PLAYBACKDEVICE1);
+    return true;
+}
+
+bool SimulatedCecAdapter::sendKeypress(cec_logical_address address, cec_user_control_code key, bool wait)
+{
+    record(Sent::SENT_KEYPRESS, address, key);
+
+    // Switching on a device makes it the active source, which it announces
+    if (key == CEC_USER_CONTROL_CODE_POWER_ON_FUNCTION && mActiveSource != address) {
+        mActiveSource = address;
+
+        cec_command cmd;
+        cec_command::Format(cmd, address, CECDEVICE_BROADCAST, CEC_OPCODE_ACTIVE_SOURCE);
+        uint16_t physical = getDevicePhysicalAddress(address);
+        cmd.PushBack(static_cast<uint8_t>(physical >> 8));
+        cmd.PushBack(static_cast<uint8_t>(physical & 0xFF));
+        mCallbacks->commandReceived(mCallbackParam, &cmd);
+    }
+
+    return true;
+}
+
+bool SimulatedCecAdapter::sendKeyRelease(cec_logical_address address, bool wait)
+{
+    record(Sent::SENT_KEYRELEASE, address);
+    return true;
+}
+
+void SimulatedCecAdapter::wait()
+{
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+bool SimulatedCecAdapter::waitSent(size_t count, int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mSentChanged.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this, count] { return mSent.size() >= count; });
+}
+
+std::vector<SimulatedCecAdapter::Press> SimulatedCecAdapter::presses()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPresses;
+}
+
+std::vector<SimulatedCecAdapter::Sent> SimulatedCecAdapter::sent()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mSent;
+}
+
+void SimulatedCecAdapter::record(Sent::Type type, cec_logical_address address, cec_user_control_code key)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSent.push_back(Sent {type, address, key});
+    mSentChanged.notify_all();
+}
+
+void SimulatedCecAdapter::command(cec_opcode opcode, cec_user_control_code key)
+{
+    cec_command cmd;
+    cec_command::Format(cmd, CECDEVICE_TV, CECDEVICE_PLAYBACKDEVICE1, opcode);
+    if (opcode == CEC_OPCODE_USER_CONTROL_PRESSED) {
+        cmd.PushBack(static_cast<uint8_t>(key));
+    }
+
+    mCallbacks->commandReceived(mCallbackParam, &cmd);
+    mCommands++;
+}
+
+void SimulatedCecAdapter::run()
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::minstd_rand rng(mSettings.seed);
+    const std::chrono::microseconds interval(1000000 / mSettings.rate);
+    Clock::time_point next = Clock::now();
+
+    // Commands go out on a fixed schedule, so a slow callback shows up as
+    // a backlog rather than a lower rate
+    auto send = [&](cec_opcode opcode, cec_user_control_code key) {
+        std::this_thread::sleep_until(next);
+        next += interval;
+        command(opcode, key);
+    };
+
+    auto hold = [&](cec_user_control_code key) {
+        Clock::time_point release = Clock::now() + std::chrono::milliseconds(mSettings.holdMs);
+        while (mRunning && next + std::chrono::milliseconds(RESEND_MS) < release) {
+            next += std::chrono::milliseconds(RESEND_MS);
+            send(CEC_OPCODE_USER_CONTROL_PRESSED, key);
+        }
+
+        next = std::max(next, release);
+    };
+
+    bool released = true;
+    cec_user_control_code last = CEC_USER_CONTROL_CODE_UNKNOWN;
+    for (unsigned int i = 0; i < mSettings.count && mRunning; i++) {
+        cec_user_control_code key = mSettings.keys[rng() % mSettings.keys.size()];
+        unsigned int roll = rng() % 100;
+        bool held = mSettings.pattern == PATTERN_HOLD || (mSettings.pattern == PATTERN_MIXED && roll < 10);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mPresses.push_back(Press {key, held, !released && key == last});
+        }
+
+        last = key;
+        send(CEC_OPCODE_USER_CONTROL_PRESSED, key);
+
+        if (held) {
+            hold(key);
+        } else if (mSettings.pattern == PATTERN_MIXED && roll < 25) {
+            // The next press replaces this one without a release
+            released = false;
+            continue;
+        }
+
+        send(CEC_OPCODE_USER_CONTROL_RELEASE, CEC_USER_CONTROL_CODE_UNKNOWN);
+        released = true;
+    }
+
+    if (!released) {
+        send(CEC_OPCODE_USER_CONTROL_RELEASE, CEC_USER_CONTROL_CODE_UNKNOWN);
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef CECFORWARDER_SIMULATEDCECADAPTER_H
+#define CECFORWARDER_SIMULATEDCECADAPTER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cecadapter.h"
+
+// Stands in for a CEC adapter. Once opened it plays a generated stream of
+// User Control Pressed and Release commands from the TV into the callbacks
+// libCEC would call, and records what the forwarder sends back.
+class SimulatedCecAdapter : public CecAdapter {
+public:
+    enum Pattern {
+        // Press and release, back to back
+        PATTERN_BURST,
+        // Every key held, with the press resent as a TV does
+        PATTERN_HOLD,
+        // Mostly taps, some holds, and presses that follow another
+        // without a release in between
+        PATTERN_MIXED,
+    };
+
+    struct Settings {
+        Pattern pattern;
+        // Key presses to generate, and commands per second
+        unsigned int count;
+        unsigned int rate;
+        unsigned int holdMs;
+        unsigned int seed;
+        std::vector<CEC::cec_user_control_code> keys;
+    };
+
+    // A key the TV pressed, not counting presses resent while it is held
+    struct Press {
+        CEC::cec_user_control_code key;
+        // Held for holdMs rather than tapped
+        bool held;
+        // Pressed again with no release since the last press of it, which
+        // only keeps it held
+        bool continued;
+    };
+
+    // What the forwarder sent to the bus
+    struct Sent {
+        enum Type {
+            SENT_POWER_ON,
+            SENT_STANDBY,
+            SENT_ACTIVE_SOURCE,
+            SENT_KEYPRESS,
+            SENT_KEYRELEASE,
+        };
+
+        Type type;
+        CEC::cec_logical_address address;
+        CEC::cec_user_control_code key;
+
+        bool operator==(const Sent& other) const
+        {
+            return type == other.type && address == other.address && key == other.key;
+        }
+    };
+
+public:
+    SimulatedCecAdapter(const Settings& settings);
+    ~SimulatedCecAdapter();
+
+    static Pattern patternFromString(const std::string& name, Pattern def = PATTERN_MIXED);
+
+    bool initialise(CEC::libcec_configuration& config) override;
+
+    bool open() override;
+    void close() override;
+
+    CEC::cec_logical_address getActiveSource() override;
+    uint16_t getDevicePhysicalAddress(CEC::cec_logical_address address) override;
+    bool powerOnDevices(CEC::cec_logical_address address) override;
+    bool standbyDevices(CEC::cec_logical_address address) override;
+    bool setActiveSource() override;
+    bool sendKeypress(CEC::cec_logical_address address, CEC::cec_user_control_code key, bool wait) override;
+    bool sendKeyRelease(CEC::cec_logical_address address, bool wait) override;
+
+    // Block until every command has been played
+    void wait();
+    // Block until the forwarder has sent count commands in all; false on
+    // timeout
+    bool waitSent(size_t count, int timeoutMs);
+
+    std::vector<Press> presses();
+    std::vector<Sent> sent();
+
+    // Commands delivered so far
+    unsigned long commands() const { return mCommands; }
+
+private:
+    void run();
+    void command(CEC::cec_opcode opcode, CEC::cec_user_control_code key = CEC::CEC_USER_CONTROL_CODE_UNKNOWN);
+    void record(Sent::Type type, CEC::cec_logical_address address,
+                CEC::cec_user_control_code key = CEC::CEC_USER_CONTROL_CODE_UNKNOWN);
+
+    Settings mSettings;
+    CEC::ICECCallbacks* mCallbacks;
+    void* mCallbackParam;
+
+    std::thread mThread;
+    std::atomic<bool> mRunning;
+    std::atomic<unsigned long> mCommands;
+    std::atomic<int> mActiveSource;
+
+    std::mutex mMutex;
+    std::condition_variable mSentChanged;
+    std::vector<Press> mPresses;
+    std::vector<Sent> mSent;
+};
+
+#endif // CECFORWARDER_SIMULATEDCECADAPTER_H
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+
+#include "eventloop.h"
+#include "log.h"
+#include "simulation.h"
+
+namespace Simulation {
+
+// How long the transmitter gets to drain once the simulator is done
+static const int DRAIN_MS = 30000;
+
+static const char* const DEFAULT_TX_FILE = "/tmp/cec-forwarder-tx.mode2";
+
+// Tap every IR key that does something on the bus, and check what the
+// simulator sees against the steps of its action. Returns the number of
+// keys whose commands differ.
+static size_t checkActions(CecForwarder& forwarder, SimulatedCecAdapter& adapter, size_t& tapped, size_t& expectedCount)
+{
+    typedef SimulatedCecAdapter::Sent Sent;
+
+    CecForwarder::BindingsPtr bindings = forwarder.bindings();
+
+    // The active source as the forwarder knows it, only ever told by the
+    // bus, and as the simulator has it
+    CEC::cec_logical_address known = adapter.getActiveSource();
+    CEC::cec_logical_address active = known;
+
+    size_t mismatched = 0;
+    tapped = expectedCount = 0;
+    for (int k = 0; k < KeyName::KEY_COUNT; k++) {
+        KeyName key(static_cast<KeyName::Value>(k));
+        const CecMacro* action = bindings->action(key);
+        if (action == nullptr) {
+            continue;
+        }
+
+        std::vector<Sent> expected;
+        unsigned int waitMs = 1000;
+        for (auto& step: *action) {
+            switch (step.type) {
+            case CecMacroStep::STEP_POWER_ON:
+                if (step.unless == CEC::CECDEVICE_UNKNOWN || known != step.unless) {
+                    expected.push_back(Sent {Sent::SENT_POWER_ON, step.address, CEC::CEC_USER_CONTROL_CODE_UNKNOWN});
+                }
+
+                break;
+            case CecMacroStep::STEP_STANDBY:
+                expected.push_back(Sent {Sent::SENT_STANDBY, step.address, CEC::CEC_USER_CONTROL_CODE_UNKNOWN});
+                break;
+            case CecMacroStep::STEP_ACTIVE_SOURCE:
+                expected.push_back(Sent {Sent::SENT_ACTIVE_SOURCE, CEC::CECDEVICE_PLAYBACKDEVICE1, CEC::CEC_USER_CONTROL_CODE_UNKNOWN});
+                active = CEC::CECDEVICE_PLAYBACKDEVICE1;
+                break;
+            case CecMacroStep::STEP_KEY:
+                expected.push_back(Sent {Sent::SENT_KEYPRESS, step.address, step.key});
+                // Switching a device on makes it the active source, which
+                // it announces
+                if (step.key == CEC::CEC_USER_CONTROL_CODE_POWER_ON_FUNCTION && active != step.address) {
+                    active = known = step.address;
+                }
+
+                expected.push_back(Sent {Sent::SENT_KEYRELEASE, step.address, CEC::CEC_USER_CONTROL_CODE_UNKNOWN});
+                break;
+            case CecMacroStep::STEP_WAIT_SOURCE:
+                if (known != step.address) {
+                    waitMs += step.timeoutMs;
+                }
+
+                break;
+            case CecMacroStep::STEP_DELAY:
+                waitMs += step.timeoutMs;
+                break;
+            }
+        }
+
+        size_t before = adapter.sent().size();
+        forwarder.onReceive(key, LircPP::EVENT_PRESS);
+        forwarder.onReceive(key, LircPP::EVENT_RELEASE);
+        adapter.waitSent(before + expected.size(), waitMs);
+
+        std::vector<Sent> sent = adapter.sent();
+        if (!std::equal(expected.begin(), expected.end(), sent.begin() + before) || sent.size() != before + expected.size()) {
+            LOG(ERROR, "Action for %s: expected %zu CEC commands, got %zu, or different ones", key.name(), expected.size(),
+                sent.size() - before);
+            mismatched++;
+        }
+
+        tapped++;
+        expectedCount += expected.size();
+    }
+
+    return mismatched;
+}
+
+// Play the simulator through the forwarder, then decode what it sent and
+// check it against the keys pressed. The IR keys with an action are
+// tapped as well, and what they send on the bus checked.
+static int simulate(CecForwarder& forwarder, SimulatedCecAdapter& adapter, const KeyTable::RemotePtr& keys, const std::string& txFile)
+{
+    if (!forwarder.ensureOpen()) {
+        return -1;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    adapter.wait();
+    bool drained = forwarder.waitTransmitIdle(DRAIN_MS);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    IRTransmitter::Stats stats = forwarder.transmitStats();
+
+    size_t tapped, actionCommands;
+    size_t mismatched = checkActions(forwarder, adapter, tapped, actionCommands);
+    forwarder.close();
+
+    // Every press is sent once. Only a held key may be sent again, as
+    // protocols without a repeat frame repeat the full one; a press that
+    // merely continues the hold sends nothing of its own. Keys without an
+    // IR code are never sent.
+    struct Expected {
+        KeyName key;
+        bool held;
+    };
+
+    std::vector<Expected> expected;
+    for (auto& press: adapter.presses()) {
+        KeyName key = forwarder.keyFor(press.key);
+        if (key.value() == KeyName::KEY_INVALID) {
+            continue;
+        }
+
+        if (press.continued && !expected.empty() && expected.back().key == key) {
+            expected.back().held = true;
+            continue;
+        }
+
+        expected.push_back(Expected {key, press.held});
+    }
+
+    LircPP lirc(keys);
+    int fd = open(txFile.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1 || !lirc.receiver().attach(fd)) {
+        LOG(ERROR, "Failed opening %s", txFile.c_str());
+        return -1;
+    }
+
+    std::vector<KeyName> sent;
+    while (!lirc.receiver().atEnd()) {
+        IRCode code;
+        if (lirc.receiveRaw(code, 1000) && !code.repeat) {
+            sent.push_back(keys->keyFor(code));
+        }
+    }
+
+    // Every frame sent should be the next press, or turn up further on,
+    // with whatever it skipped over dropped. A frame that is neither the
+    // next press nor a repeat of a held one is unexpected. Where a repeat
+    // and a second press of the same key can't be told apart it counts
+    // as the press.
+    size_t pos = 0, dropped = 0, unexpected = 0;
+    for (auto& key: sent) {
+        if (pos < expected.size() && expected[pos].key == key) {
+            pos++;
+            continue;
+        }
+
+        if (pos > 0 && expected[pos - 1].held && expected[pos - 1].key == key) {
+            continue;
+        }
+
+        auto it = std::find_if(expected.begin() + pos, expected.end(), [&key](const Expected& e) { return e.key == key; });
+        if (it == expected.end()) {
+            unexpected++;
+            continue;
+        }
+
+        dropped += it - (expected.begin() + pos);
+        pos = it - expected.begin() + 1;
+    }
+
+    dropped += expected.size() - pos;
+
+    LOG(NOTICE, "%lu CEC commands, %zu presses in %gs", adapter.commands(), adapter.presses().size(), seconds);
+    LOG(NOTICE, "Keys: %zu expected, %zu frames sent, %zu dropped, %zu unexpected", expected.size(), sent.size(),
+        dropped, unexpected);
+    LOG(NOTICE, "Queue: max depth %zu, %llu dropped, %llu coalesced, max wait %lluus", stats.maxDepth,
+        static_cast<unsigned long long>(stats.dropped), static_cast<unsigned long long>(stats.coalesced),
+        static_cast<unsigned long long>(stats.maxWaitUs));
+    LOG(NOTICE, "Actions: %zu IR keys tapped, %zu CEC commands expected, %zu mismatched", tapped, actionCommands,
+        mismatched);
+    if (!drained) {
+        LOG(ERROR, "Transmitter did not drain");
+    }
+
+    return (drained && dropped == 0 && unexpected == 0 && mismatched == 0) ? 0 : 1;
+}
+
+SimulatedCecAdapter::Settings settings(const ConfigFile& config)
+{
+    SimulatedCecAdapter::Settings settings;
+    settings.pattern = SimulatedCecAdapter::PATTERN_MIXED;
+    settings.count = 500;
+    settings.rate = 20;
+    settings.holdMs = 1500;
+    settings.seed = 1;
+
+    const ConfigFile::Section* simulatorSection = config.getSection("Simulator");
+    if (simulatorSection != nullptr) {
+        settings.pattern = SimulatedCecAdapter::patternFromString(simulatorSection->value("pattern"));
+        settings.count = simulatorSection->intValue("count", settings.count);
+        settings.rate = simulatorSection->intValue("rate", settings.rate);
+        settings.holdMs = simulatorSection->intValue("holdms", settings.holdMs);
+        settings.seed = simulatorSection->intValue("seed", settings.seed);
+    }
+
+    const ConfigFile::Section* keySection = config.getSection("Keys");
+    if (keySection != nullptr) {
+        for (auto it = keySection->begin(); it != keySection->end(); it++) {
+            settings.keys.push_back(static_cast<CEC::cec_user_control_code>(std::atoi(it->key) & 0xFF));
+        }
+    }
+
+    return settings;
+}
+
+int run(CecForwarder& forwarder, SimulatedCecAdapter& adapter, const ConfigFile& config)
+{
+    const ConfigFile::Section* simulatorSection = config.getSection("Simulator");
+    std::string txFile = (simulatorSection != nullptr) ? simulatorSection->value("txfile", DEFAULT_TX_FILE) : DEFAULT_TX_FILE;
+    if (!forwarder.setTransmitFile(txFile)) {
+        return -1;
+    }
+
+    // The repeat timer still needs a loop to run on
+    EventLoop loop;
+    EventNotifier done;
+    forwarder.attach(loop);
+    loop.add(done.fd(), [&loop] { loop.stop(); });
+    std::thread loopThread([&loop] { loop.run(); });
+
+    int ret = simulate(forwarder, adapter, forwarder.bindings()->keys(), txFile);
+
+    done.notify();
+    loopThread.join();
+    return ret;
+}
+
+}
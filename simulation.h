@@ -0,0 +1,24 @@
+#ifndef CECFORWARDER_SIMULATION_H
+#define CECFORWARDER_SIMULATION_H
+
+#include "cecforwarder.h"
+#include "configfile.h"
+#include "simulatedcecadapter.h"
+
+// --simulate: the forwarder is driven by a SimulatedCecAdapter instead of
+// a real adapter and transmits to a file, which is then decoded and checked
+// against the keys the simulator pressed
+namespace Simulation {
+
+// The simulator's settings from the Simulator section of config, pressing
+// the CEC key codes of its Keys section
+SimulatedCecAdapter::Settings settings(const ConfigFile& config);
+
+// Play adapter, which forwarder must have been created with, through the
+// forwarder and report what came out. Returns 0 if every key and action
+// checked out, 1 if any didn't, and -1 if the simulation couldn't run.
+int run(CecForwarder& forwarder, SimulatedCecAdapter& adapter, const ConfigFile& config);
+
+}
+
+#endif // CECFORWARDER_SIMULATION_H
@@ -0,0 +1,64 @@
+#ifndef CECFORWARDER_SPSCRING_H
+#define CECFORWARDER_SPSCRING_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue between exactly one producer and one consumer
+// thread. Neither side ever blocks; a push into a full ring fails and is
+// left to the caller to count. Size must be a power of two.
+template <typename T, size_t Size>
+class SpscRing {
+    static_assert(Size > 0 && (Size & (Size - 1)) == 0, "ring size must be a power of two");
+
+public:
+    SpscRing()
+        : mHead(0)
+        , mTail(0)
+    {
+    }
+
+    // Producer side
+    bool push(const T& value)
+    {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load(std::memory_order_acquire) == Size) {
+            return false;
+        }
+
+        mSlots[tail & (Size - 1)] = value;
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T& value)
+    {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = mSlots[head & (Size - 1)];
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Exact from either side for its own view, approximate otherwise
+    size_t size() const
+    {
+        return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() { return Size; }
+
+private:
+    // Indices run freely and are masked on use; each on its own cache line
+    // so the two threads don't keep stealing it from each other
+    alignas(64) std::atomic<size_t> mHead;
+    alignas(64) std::atomic<size_t> mTail;
+    alignas(64) std::array<T, Size> mSlots;
+};
+
+#endif // CECFORWARDER_SPSCRING_H